@@ -0,0 +1,232 @@
+#define _GNU_SOURCE  // for the writer-preferring rwlock
+#include "batch.h"
+
+typedef struct batch_item {
+  Graph G;
+  char *name;
+  unsigned long index;  // line of the manifest, used to derive the seed
+  double load_time;
+} BatchItem;
+
+/* Loaders take the next line of the manifest and push the loaded graph to
+ * the queue, which is closed by the last loader to finish. Workers pop the
+ * graphs and color them: small graphs with their own single-thread context
+ * while holding the read side of the lock, so that many of them are colored
+ * at the same time, large graphs with the shared context of n_workers threads
+ * while holding the write side, so that they have the whole machine.
+ */
+typedef struct batch_struct {
+  BatchConfig *config;
+  Queue queue;
+  pthread_mutex_t manifest_lock;
+  unsigned long lines_read;
+  unsigned int loaders_running;
+  pthread_rwlock_t machine;
+  ColoringContext large_ctx;
+  pthread_mutex_t out_lock;
+  unsigned long colored, failed;
+} batch_t;
+
+static void strip_newline(char *line) {
+  line[strcspn(line, "\r\n")] = '\0';
+}
+
+static void *load_graphs(void *par) {
+  batch_t *b = (batch_t *)par;
+  char *line = NULL;
+  size_t size = 0;
+  for (;;) {
+    pthread_mutex_lock(&b->manifest_lock);
+    ssize_t len = getline(&line, &size, b->config->manifest);
+    unsigned long index = b->lines_read++;
+    pthread_mutex_unlock(&b->manifest_lock);
+    if (len < 0) {
+      break;
+    }
+    strip_newline(line);
+    if (line[0] == '\0' || line[0] == '#') {
+      continue;  // skip empty lines and comments
+    }
+
+    double start = UTIL_get_time();
+    Graph G = GEN_is_spec(line)
+                  ? GEN_generate(line, 1, b->config->fixed_seed
+                                              ? b->config->seed
+                                              : GEN_DEFAULT_SEED)
+                  : GRAPH_load_from_file(line);
+    BatchItem *item = malloc(sizeof(BatchItem));
+    char *name = strdup(line);
+    if (G == NULL || item == NULL || name == NULL) {
+      pthread_mutex_lock(&b->out_lock);
+      fprintf(b->config->out, "%s,,,,,,,load_failed\n", line);
+      b->failed++;
+      pthread_mutex_unlock(&b->out_lock);
+      GRAPH_free(G);
+      free(item);
+      free(name);
+      continue;
+    }
+    item->G = G;
+    item->name = name;
+    item->index = index;
+    item->load_time = UTIL_get_time() - start;
+    if (!QUEUE_push(b->queue, item)) {
+      GRAPH_free(G);
+      free(name);
+      free(item);
+      break;
+    }
+  }
+  free(line);
+
+  pthread_mutex_lock(&b->manifest_lock);
+  if (--b->loaders_running == 0) {
+    QUEUE_close(b->queue);  // the workers stop once the queue is empty
+  }
+  pthread_mutex_unlock(&b->manifest_lock);
+  return NULL;
+}
+
+static void *color_graphs(void *par) {
+  batch_t *b = (batch_t *)par;
+  BatchConfig *config = b->config;
+  ColoringContext small_ctx = GRAPH_context_create(1);
+  if (small_ctx == NULL) {
+    return NULL;
+  }
+  BatchItem *item;
+  while ((item = QUEUE_pop(b->queue)) != NULL) {
+    Graph G = item->G;
+    unsigned int large = GRAPH_get_vertex_count(G) >= config->large_vertices;
+    ColoringContext ctx = large ? b->large_ctx : small_ctx;
+    unsigned int n_threads = GRAPH_context_get_threads(ctx);
+    if (large) {
+      pthread_rwlock_wrlock(&b->machine);
+    } else {
+      pthread_rwlock_rdlock(&b->machine);
+    }
+
+    for (unsigned int m = 0; m < config->n_methods; m++) {
+      unsigned long long seed =
+          config->fixed_seed ? config->seed
+                             : UTIL_splitmix64(config->seed + item->index);
+      ColoringReport report;
+      memset(&report, 0, sizeof(ColoringReport));
+      double start = UTIL_get_time();
+      unsigned int *colors =
+          GRAPH_context_color(ctx, G, config->methods[m], seed, NULL);
+      double finish = UTIL_get_time();
+      if (colors != NULL) {
+        /* with the single-thread context of the small graphs, this runs on
+         * the worker itself */
+        GRAPH_validate_coloring(G, colors, n_threads,
+                                GRAPH_MAX_REPORTED_CONFLICTS, &report);
+        free(report.class_size);
+      }
+
+      /* the colors used are left empty if the validation didn't finish */
+      char colors_used[16] = "";
+      if (colors != NULL && !report.aborted && !report.failed) {
+        snprintf(colors_used, sizeof(colors_used), "%d",
+                 report.stats.colors_used);
+      }
+      pthread_mutex_lock(&b->out_lock);
+      fprintf(config->out, "%s,%d,%s,%d,%09f,%09f,%s,%s\n", item->name,
+              GRAPH_get_vertex_count(G),
+              GRAPH_coloring_methods[config->methods[m]], n_threads,
+              item->load_time, finish - start, colors_used,
+              colors == NULL    ? "color_failed"
+              : report.failed   ? "validate_failed"
+              : report.valid    ? "yes"
+                                : "no");
+      if (colors != NULL && report.valid) {
+        b->colored++;
+      } else {
+        b->failed++;
+      }
+      pthread_mutex_unlock(&b->out_lock);
+    }
+
+    pthread_rwlock_unlock(&b->machine);
+    GRAPH_free(G);
+    free(item->name);
+    free(item);
+  }
+  GRAPH_context_free(small_ctx);
+  return NULL;
+}
+
+/* EXPOSED FUNCTIONS */
+
+/* Colors every graph listed in the manifest with every configured method,
+ * streaming a csv row for each coloring to config->out as soon as it's done,
+ * in completion order. Returns 0 if any graph couldn't be loaded or colored
+ * correctly, 1 otherwise.
+ */
+int BATCH_run(BatchConfig *config) {
+  batch_t b;
+  memset(&b, 0, sizeof(batch_t));
+  b.config = config;
+  b.queue = QUEUE_init(2 * config->n_workers);  // bounds the loaded graphs
+  b.large_ctx = GRAPH_context_create(config->n_workers);
+  if (b.queue == NULL || b.large_ctx == NULL) {
+    QUEUE_free(b.queue);
+    GRAPH_context_free(b.large_ctx);
+    return 0;
+  }
+  pthread_mutex_init(&b.manifest_lock, NULL);
+  pthread_mutex_init(&b.out_lock, NULL);
+  /* a writer-preferring lock, otherwise a steady stream of small graphs would
+   * starve the large ones */
+  pthread_rwlockattr_t attr;
+  pthread_rwlockattr_init(&attr);
+  pthread_rwlockattr_setkind_np(&attr,
+                                PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+  pthread_rwlock_init(&b.machine, &attr);
+  pthread_rwlockattr_destroy(&attr);
+  b.loaders_running = config->n_loaders;
+
+  pthread_t *loaders = malloc(config->n_loaders * sizeof(pthread_t));
+  pthread_t *workers = malloc(config->n_workers * sizeof(pthread_t));
+  if (loaders == NULL || workers == NULL) {
+    fprintf(stderr, "Error allocating batch threads!\n");
+    free(loaders);
+    free(workers);
+    return 0;
+  }
+
+  fprintf(config->out,
+          "graph_name,vertex_count,coloring_method,n_threads,load_time,"
+          "coloring_time,colors_used,valid\n");
+  double start = UTIL_get_time();
+  for (unsigned int i = 0; i < config->n_loaders; i++) {
+    pthread_create(&loaders[i], NULL, load_graphs, (void *)&b);
+  }
+  for (unsigned int i = 0; i < config->n_workers; i++) {
+    pthread_create(&workers[i], NULL, color_graphs, (void *)&b);
+  }
+  for (unsigned int i = 0; i < config->n_loaders; i++) {
+    pthread_join(loaders[i], NULL);
+  }
+  for (unsigned int i = 0; i < config->n_workers; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  double elapsed = UTIL_get_time() - start;
+  fflush(config->out);
+
+  unsigned long graphs = config->n_methods ? b.colored / config->n_methods : 0;
+  fprintf(stderr,
+          "Colored %lu graphs (%lu colorings, %lu failed) in %f s: %.2f "
+          "graphs/s\n",
+          graphs, b.colored, b.failed, elapsed,
+          elapsed > 0 ? graphs / elapsed : 0);
+
+  free(loaders);
+  free(workers);
+  pthread_rwlock_destroy(&b.machine);
+  pthread_mutex_destroy(&b.manifest_lock);
+  pthread_mutex_destroy(&b.out_lock);
+  GRAPH_context_free(b.large_ctx);
+  QUEUE_free(b.queue);
+  return b.failed == 0;
+}
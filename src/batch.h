@@ -0,0 +1,31 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "gen.h"
+#include "graph.h"
+#include "queue.h"
+#include "util.h"
+
+#define BATCH_DEFAULT_LARGE_VERTICES 100000
+
+typedef struct batch_config {
+  FILE *manifest;  // one graph path (or generator spec) per line
+  FILE *out;       // where the csv rows are streamed
+  ColoringMethod *methods;
+  unsigned int n_methods;
+  unsigned int n_workers;
+  unsigned int n_loaders;
+  unsigned int large_vertices;  // graphs with at least this many vertices
+                                // are colored with all the workers' threads
+  int fixed_seed;
+  unsigned long long seed;
+} BatchConfig;
+
+int BATCH_run(BatchConfig *config);
+
+#endif
@@ -0,0 +1,197 @@
+#include "bench.h"
+
+/* two-sided 95% critical values of Student's t distribution, for 1 to 30
+ * degrees of freedom; above 30 the normal value 1.96 is used */
+static const double t_critical_95[30] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/* p-th percentile of the sorted samples, interpolating linearly between the
+ * two closest ranks */
+static double percentile(double *sorted, unsigned int n, double p) {
+  double rank = p * (n - 1);
+  unsigned int low = (unsigned int)rank;
+  if (low + 1 >= n) {
+    return sorted[n - 1];
+  }
+  return sorted[low] + (rank - low) * (sorted[low + 1] - sorted[low]);
+}
+
+static int is_sequential(ColoringMethod method) {
+  return method == GRAPH_SEQ_GREEDY || method == GRAPH_SEQ_LDF ||
+         method == GRAPH_SEQ_DENSE_GREEDY || method == GRAPH_SEQ_DENSE_DSATUR;
+}
+
+static int is_dense(ColoringMethod method) {
+  return method == GRAPH_SEQ_DENSE_GREEDY || method == GRAPH_SEQ_DENSE_DSATUR;
+}
+
+/* EXPOSED FUNCTIONS */
+
+/* Sorts the samples in place and computes their median, 10th and 90th
+ * percentiles, mean, and the 95% confidence interval of the mean.
+ */
+void BENCH_summarize(double *samples, unsigned int n, BenchSummary *summary) {
+  memset(summary, 0, sizeof(BenchSummary));
+  summary->runs = n;
+  if (n == 0) {
+    return;
+  }
+  qsort(samples, n, sizeof(double), compare_doubles);
+  summary->median = percentile(samples, n, 0.5);
+  summary->p10 = percentile(samples, n, 0.1);
+  summary->p90 = percentile(samples, n, 0.9);
+
+  double sum = 0, squares = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    sum += samples[i];
+  }
+  summary->mean = sum / n;
+  for (unsigned int i = 0; i < n; i++) {
+    squares += (samples[i] - summary->mean) * (samples[i] - summary->mean);
+  }
+  double half_width = 0;
+  if (n > 1) {
+    double t = n - 1 <= 30 ? t_critical_95[n - 2] : 1.96;
+    half_width = t * sqrt(squares / (n - 1)) / sqrt(n);
+  }
+  summary->ci95_low = summary->mean - half_width;
+  summary->ci95_high = summary->mean + half_width;
+}
+
+void BENCH_write_csv_header(FILE *csv_file) {
+  fprintf(csv_file,
+          "graph_name,vertex_count,coloring_method,n_threads,warmup,runs,"
+          "invalid_runs,colors_used,median,p10,p90,mean,ci95_low,ci95_high,"
+          "speedup,efficiency\n");
+}
+
+/* Colors the graph with every configured method and thread count, doing
+ * config->warmup discarded colorings followed by config->runs measured ones.
+ * Run r uses the same seed for every method and thread count, so that the
+ * samples only differ in the timings. The speedup of a parallel method is
+ * relative to its own median with the first (lowest) thread count of the
+ * sweep. If best isn't NULL, the method and thread count with the lowest
+ * median among the ones without invalid runs are written to it (an empty
+ * method if there are none), for the calibration table. A coloring that
+ * fails counts as an invalid run of its method and thread count, whose
+ * statistics only cover the other runs. Returns 0 if any measured coloring
+ * was invalid or failed, 1 otherwise.
+ */
+int BENCH_run_graph(Graph G, char *graph_name, BenchConfig *config,
+                    FILE *csv_file, CalibEntry *best) {
+  double *samples = malloc(config->runs * sizeof(double));
+  if (samples == NULL) {
+    printf("Error allocating benchmark samples!\n");
+    return 0;
+  }
+  int all_valid = 1;
+  ColoringReport report;
+  double best_median = -1;
+  if (best != NULL) {
+    best->method[0] = '\0';
+  }
+
+  printf(
+      "COLOR METHOD | THREADS | RUNS | MEDIAN    | P10       | P90       | "
+      "MEAN +/- CI95          | SPEEDUP | EFFICIENCY | COLORS USED | VALID?\n");
+  for (unsigned int m = 0; m < config->n_methods; m++) {
+    ColoringMethod method = config->methods[m];
+    const char *name = GRAPH_coloring_methods[method];
+    if ((config->par_only && is_sequential(method)) ||
+        (is_dense(method) && !GRAPH_fits_dense(G))) {
+      continue;
+    }
+    double base_median = 0;
+    for (unsigned int t = 0; t < config->n_thread_counts; t++) {
+      unsigned int n_threads = config->thread_counts[t];
+      if (is_sequential(method) && t > 0) {
+        break;  // the thread count doesn't affect sequential methods
+      }
+      unsigned int invalid_runs = 0, failed_runs = 0, colors_used = 0;
+      unsigned int n_samples = 0;
+      for (unsigned int r = 0; r < config->warmup + config->runs; r++) {
+        unsigned long long seed =
+            config->fixed_seed
+                ? config->seed
+                : UTIL_splitmix64(config->seed + r - config->warmup);
+        double start = UTIL_get_time();
+        unsigned int *colors =
+            GRAPH_context_color(config->contexts[t], G, method, seed, NULL);
+        double finish = UTIL_get_time();
+        if (colors == NULL) {
+          /* only this method and thread count are affected */
+          if (r >= config->warmup) {
+            failed_runs++;
+            invalid_runs++;
+          }
+          continue;
+        }
+        if (r < config->warmup) {
+          continue;
+        }
+        samples[n_samples++] = finish - start;
+        GRAPH_validate_coloring(G, colors, n_threads,
+                                GRAPH_MAX_REPORTED_CONFLICTS, &report);
+        free(report.class_size);
+        if (!report.valid) {
+          invalid_runs++;
+        } else {
+          colors_used = report.stats.colors_used;
+        }
+      }
+
+      BenchSummary s;
+      BENCH_summarize(samples, n_samples, &s);
+      if (t == 0) {
+        base_median = s.median;
+      }
+      double speedup = s.median > 0 ? base_median / s.median : 0;
+      double efficiency =
+          speedup * config->thread_counts[0] / (double)n_threads;
+
+      printf("%12s | %7d | %4d | %09f | %09f | %09f | %09f +/- %09f | ",
+             name, n_threads, s.runs, s.median, s.p10, s.p90, s.mean,
+             s.ci95_high - s.mean);
+      if (is_sequential(method)) {
+        printf("    -   |      -     | ");
+      } else {
+        printf("%7.2f | %10.2f | ", speedup, efficiency);
+      }
+      printf("    %02d      | ", colors_used);
+      if (invalid_runs == 0) {
+        printf("YES\n");
+        if (best != NULL && method != GRAPH_AUTO &&
+            (best_median < 0 || s.median < best_median)) {
+          best_median = s.median;
+          snprintf(best->method, CALIB_METHOD_LEN, "%s", name);
+          best->n_threads = is_sequential(method) ? 1 : n_threads;
+        }
+      } else if (failed_runs > 0) {
+        printf("NO (%d invalid runs, %d failed)\n", invalid_runs, failed_runs);
+        all_valid = 0;
+      } else {
+        printf("NO (%d invalid runs)\n", invalid_runs);
+        all_valid = 0;
+      }
+
+      if (csv_file != NULL) {
+        fprintf(csv_file,
+                "%s,%d,%s,%d,%d,%d,%d,%d,%09f,%09f,%09f,%09f,%09f,%09f,%f,"
+                "%f\n",
+                graph_name, GRAPH_get_vertex_count(G), name, n_threads,
+                config->warmup, s.runs, invalid_runs, colors_used, s.median,
+                s.p10, s.p90, s.mean, s.ci95_low, s.ci95_high, speedup,
+                efficiency);
+      }
+    }
+  }
+  free(samples);
+  return all_valid;
+}
@@ -0,0 +1,40 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "calib.h"
+#include "graph.h"
+#include "util.h"
+
+typedef struct bench_config {
+  ColoringMethod *methods;
+  unsigned int n_methods;
+  ColoringContext *contexts;    // a context for each thread count
+  unsigned int *thread_counts;  // the thread counts to sweep, ascending
+  unsigned int n_thread_counts;
+  unsigned int warmup;  // colorings done and discarded before measuring
+  unsigned int runs;    // measured colorings
+  int par_only;
+  int fixed_seed;
+  unsigned long long seed;  // used by every run if fixed_seed, else the
+                            // base of the per-run seeds
+} BenchConfig;
+
+typedef struct bench_summary {
+  unsigned int runs;
+  double median;
+  double p10, p90;
+  double mean;
+  double ci95_low, ci95_high;  // 95% confidence interval of the mean
+} BenchSummary;
+
+void BENCH_summarize(double *samples, unsigned int n, BenchSummary *summary);
+void BENCH_write_csv_header(FILE *csv_file);
+int BENCH_run_graph(Graph G, char *graph_name, BenchConfig *config,
+                    FILE *csv_file, CalibEntry *best);
+
+#endif
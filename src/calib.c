@@ -0,0 +1,118 @@
+#include "calib.h"
+
+/* Default calibration table, used when no calibration file is found.
+ * The rows come from the results table in the README (i7-6700k, 8 threads),
+ * with approximate features of the corresponding graphs. Running grcolor with
+ * '--calibrate' regenerates the table on the current machine.
+ */
+static CalibEntry default_table[] = {
+    {1000, 490.0, 1.1, "seq_ldf", 1},            // v1000.gra
+    {3617, 2.2, 30.0, "seq_greedy", 1},          // kegg_dag_uniq.gra
+    {10000, 10.0, 25.0, "par_ldf_plus", 8},      // ba10k5d.gra
+    {32768, 9.9, 2.3, "par_jp", 8},              // rgg_n_2_15_s0.graph
+    {1048576, 13.2, 2.0, "par_ldf_plus", 8},     // rgg_n_2_20_s0.graph
+    {16777216, 15.8, 2.0, "par_ldf_plus", 8},    // rgg_n_2_24_s0.graph
+    {3774768, 8.8, 90.0, "par_ldf_plus", 8},     // cit-Patents.scc.gra
+    {6968555, 9.8, 5000.0, "par_ldf_plus", 8},   // go_uniprot.gra
+    {1595444, 2.0, 1000.0, "par_ldf", 8},        // uniprotenc_22m.scc.gra
+    {16087295, 2.0, 5000.0, "par_ldf", 8}};      // uniprotenc_100m.scc.gra
+
+static CalibEntry *table = default_table;
+static unsigned int table_size = sizeof(default_table) / sizeof(CalibEntry);
+
+static double log_distance(double a, double b) {
+  double d = log(a + 1) - log(b + 1);
+  return d * d;
+}
+
+/* EXPOSED FUNCTIONS */
+
+int CALIB_load(char *filename) {
+  FILE *fp = fopen(filename, "r");
+  if (fp == NULL) {
+    return 0;  // not an error, the default table is used
+  }
+  char line[256];
+  CalibEntry entry, *entries = NULL;
+  unsigned int n = 0;
+
+  fgets(line, sizeof(line), fp);  // skip the header line
+  while (fgets(line, sizeof(line), fp)) {
+    if (sscanf(line, "%u,%lf,%lf,%31[^,],%u", &entry.vertex_count,
+               &entry.avg_degree, &entry.degree_skew, entry.method,
+               &entry.n_threads) != 5 ||
+        entry.n_threads == 0) {
+      fprintf(stderr, "Skipping invalid calibration line: %s", line);
+      continue;
+    }
+    /* the method is checked now rather than when 'auto' picks it, and 'auto'
+     * itself would select a method forever */
+    ColoringMethod method = GRAPH_coloring_method_from_str(entry.method);
+    if (method == -1 || method == GRAPH_AUTO) {
+      fprintf(stderr,
+              "Skipping calibration line with invalid method '%s': %s",
+              entry.method, line);
+      continue;
+    }
+    CalibEntry *tmp = realloc(entries, (n + 1) * sizeof(CalibEntry));
+    if (tmp == NULL) {
+      fprintf(stderr, "Error allocating calibration table!\n");
+      break;
+    }
+    entries = tmp;
+    entries[n++] = entry;
+  }
+  fclose(fp);
+
+  if (n == 0) {
+    free(entries);
+    return 0;
+  }
+  if (table != default_table) {
+    free(table);
+  }
+  table = entries;
+  table_size = n;
+  return n;
+}
+
+int CALIB_save(char *filename, CalibEntry *entries, unsigned int n) {
+  FILE *fp = fopen(filename, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "Error opening %s\n", filename);
+    return 0;
+  }
+  fprintf(fp, "vertex_count,avg_degree,degree_skew,method,n_threads\n");
+  for (unsigned int i = 0; i < n; i++) {
+    fprintf(fp, "%u,%f,%f,%s,%u\n", entries[i].vertex_count,
+            entries[i].avg_degree, entries[i].degree_skew, entries[i].method,
+            entries[i].n_threads);
+  }
+  fclose(fp);
+  return 1;
+}
+
+/* Returns the method of the calibration entry closest to the given
+ * features (in log scale, since the features span orders of magnitude) and
+ * writes its number of threads, lowered to max_threads if needed.
+ */
+const char *CALIB_select(GraphFeatures *features, unsigned int max_threads,
+                         unsigned int *n_threads) {
+  unsigned int best = 0;
+  double best_distance = -1;
+  for (unsigned int i = 0; i < table_size; i++) {
+    double distance =
+        log_distance(features->vertex_count, table[i].vertex_count) +
+        log_distance(features->avg_degree, table[i].avg_degree) +
+        log_distance(features->degree_skew, table[i].degree_skew);
+    if (best_distance < 0 || distance < best_distance) {
+      best = i;
+      best_distance = distance;
+    }
+  }
+  *n_threads = table[best].n_threads;
+  if (*n_threads > max_threads) {
+    *n_threads = max_threads;
+  }
+  return table[best].method;
+}
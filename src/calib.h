@@ -0,0 +1,27 @@
+#ifndef CALIB_H
+#define CALIB_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "graph.h"
+
+#define CALIB_DEFAULT_FILENAME "calibration.csv"
+#define CALIB_METHOD_LEN 32
+
+typedef struct calib_entry {
+  unsigned int vertex_count;
+  double avg_degree;
+  double degree_skew;
+  char method[CALIB_METHOD_LEN];
+  unsigned int n_threads;
+} CalibEntry;
+
+int CALIB_load(char *filename);
+int CALIB_save(char *filename, CalibEntry *entries, unsigned int n);
+const char *CALIB_select(GraphFeatures *features, unsigned int max_threads,
+                         unsigned int *n_threads);
+
+#endif
@@ -0,0 +1,594 @@
+#include "dist.h"
+
+struct dist_graph {
+  MPI_Comm comm;
+  int rank, size;
+  unsigned int V;
+  unsigned long E;
+  unsigned int first, n;        // owned vertices: [first, first + n)
+  unsigned int *vertex_first;   // first vertex of each rank, and V
+  unsigned long *xadj;          // neighbours of v are in
+  unsigned int *adj;            // adj[xadj[v]..xadj[v + 1]), local indexes
+  unsigned int max_degree;
+  unsigned int n_ghosts;
+  unsigned int *ghost_gid;      // global index of each ghost, ascending
+  int *send_offsets;            // owned vertices adjacent to the ghosts of
+  unsigned int *send_vertices;  // rank p are in send_vertices[send_offsets[p]
+                                // ..send_offsets[p + 1])
+};
+
+/* the lines of the slice parsed so far, with global (0-based) neighbours */
+typedef struct slice_struct {
+  unsigned long *xadj;
+  unsigned long lines, lines_capacity;
+  unsigned int *adj;
+  unsigned long edges, edges_capacity;
+} slice_t;
+
+/* buffers of the exchanges of the ghosts' colors, sized once */
+typedef struct exchange_struct {
+  unsigned int *send_buffer;  // (global index, color) pairs
+  unsigned int *recv_buffer;
+  unsigned long recv_capacity;
+  int *send_counts, *send_displs;
+  int *recv_counts, *recv_displs;
+} exchange_t;
+
+/* UTILITY FUNCTIONS */
+
+static int grow(void **buffer, unsigned long *capacity, unsigned long needed,
+                size_t item_size) {
+  if (needed <= *capacity) {
+    return 1;
+  }
+  unsigned long size = *capacity ? 2 * *capacity : 1024;
+  while (size < needed) {
+    size *= 2;
+  }
+  void *tmp = realloc(*buffer, size * item_size);
+  if (tmp == NULL) {
+    printf("Error growing a buffer!\n");
+    return 0;
+  }
+  *buffer = tmp;
+  *capacity = size;
+  return 1;
+}
+
+/* whether every rank succeeded, so that they all give up together instead of
+ * waiting for the ones that failed */
+static int all_ok(MPI_Comm comm, int ok) {
+  int all;
+  MPI_Allreduce(&ok, &all, 1, MPI_INT, MPI_MIN, comm);
+  return all;
+}
+
+static int compare_uints(const void *a, const void *b) {
+  unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+  return (x > y) - (x < y);
+}
+
+/* the rank owning vertex gid, with the same search the ranks without vertices
+ * are skipped by */
+static int owner(DistGraph G, unsigned int gid) {
+  int low = 0, high = G->size;
+  while (high - low > 1) {
+    int mid = (low + high) / 2;
+    if (G->vertex_first[mid] <= gid) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+/* the local index of ghost gid, or 0 if it isn't a ghost of the rank */
+static unsigned int ghost_index(DistGraph G, unsigned int gid) {
+  unsigned int *found = bsearch(&gid, G->ghost_gid, G->n_ghosts,
+                                sizeof(unsigned int), compare_uints);
+  return found != NULL ? G->n + (found - G->ghost_gid) : 0;
+}
+
+/* Appends a vertex line of a METIS file to the slice, with the same formats
+ * (fmt and ncon) accepted by GRAPH_load_from_file */
+static int parse_line(char *line, unsigned int fmt, unsigned int ncon,
+                      unsigned int V, slice_t *s) {
+  char *p = line, *e;
+  int alternate = 0;
+  unsigned int to;
+  if (fmt == 100) {
+    fmt = ncon != 0 ? 10 : 0;
+  }
+  switch (fmt) {
+    case 10:
+      for (int i = 0; i < ncon; i++, p = e) {
+        strtol(p, &e, 10);  // skip the vertex's weights
+      }
+    case 0:
+      alternate = 0;
+      break;
+    case 11:
+      strtol(p, &e, 10);
+      p = e;
+    case 1:
+      alternate = 1;
+      break;
+    default:
+      printf("Invalid fmt\n");
+      return 0;
+  }
+  for (unsigned int k = 0;; p = e, k++) {
+    to = strtol(p, &e, 10);
+    if (p == e) break;
+    if (alternate && k % 2 == 1) {
+      continue;  // an edge's weight
+    }
+    if (to == 0 || to > V) {
+      continue;
+    }
+    if (!grow((void **)&s->adj, &s->edges_capacity, s->edges + 1,
+              sizeof(unsigned int))) {
+      return 0;
+    }
+    s->adj[s->edges++] = to - 1;
+  }
+  if (!grow((void **)&s->xadj, &s->lines_capacity, s->lines + 2,
+            sizeof(unsigned long))) {
+    return 0;
+  }
+  s->xadj[++s->lines] = s->edges;
+  return 1;
+}
+
+/* Parses the lines of the METIS file starting in the rank's share of the
+ * bytes after the header: a rank starts at the first line beginning in its
+ * share, and stops at the first line beginning in the next one, so that
+ * every line is parsed by exactly one rank.
+ */
+static int parse_slice(FILE *fp, DistGraph G, unsigned int *fmt,
+                       unsigned int *ncon, slice_t *s) {
+  char *line = NULL;
+  size_t size = 0;
+  unsigned int E = 0;
+  *fmt = *ncon = 0;
+  do {
+    if (getline(&line, &size, fp) < 0) {
+      free(line);
+      printf("Missing METIS header\n");
+      return 0;
+    }
+  } while (line[0] == '%');
+  sscanf(line, "%u %u %u %u", &G->V, &E, fmt, ncon);
+  long data_start = ftell(fp);
+  fseek(fp, 0, SEEK_END);
+  long data_end = ftell(fp);
+  long begin = data_start + (data_end - data_start) * G->rank / G->size;
+  long end = data_start + (data_end - data_start) * (G->rank + 1) / G->size;
+
+  fseek(fp, begin - 1, SEEK_SET);
+  for (int c = getc(fp); c != '\n' && c != EOF; c = getc(fp)) {
+    // the line started in the previous rank's share
+  }
+  s->xadj = NULL;
+  s->adj = NULL;
+  s->lines = s->lines_capacity = s->edges = s->edges_capacity = 0;
+  if (!grow((void **)&s->xadj, &s->lines_capacity, 1, sizeof(unsigned long))) {
+    free(line);
+    return 0;
+  }
+  s->xadj[0] = 0;
+  while (ftell(fp) < end && getline(&line, &size, fp) >= 0) {
+    if (line[0] == '%') {
+      continue;
+    }
+    if (!parse_line(line, *fmt, *ncon, G->V, s)) {
+      free(line);
+      return 0;
+    }
+  }
+  free(line);
+  return 1;
+}
+
+/* Turns the neighbours' global indexes into local ones, numbering the ghosts
+ * after the owned vertices, and lists which owned vertices each rank needs
+ * the colors of.
+ */
+static int index_ghosts(DistGraph G, slice_t *s) {
+  unsigned long n_edges = s->xadj[G->n];
+  G->xadj = malloc(((unsigned long)G->n + 1) * sizeof(unsigned long));
+  /* one spare slot, so that a slice without edges still gets a buffer */
+  G->adj = malloc((n_edges + 1) * sizeof(unsigned int));
+  unsigned int *ghosts = malloc((n_edges + 1) * sizeof(unsigned int));
+  if (G->xadj == NULL || G->adj == NULL || ghosts == NULL) {
+    printf("Error allocating the adjacency lists!\n");
+    free(ghosts);
+    return 0;
+  }
+
+  /* drop the self loops, and collect the distinct ghosts */
+  unsigned long k = 0, n_ghosts = 0;
+  G->xadj[0] = 0;
+  for (unsigned int v = 0; v < G->n; v++) {
+    for (unsigned long j = s->xadj[v]; j < s->xadj[v + 1]; j++) {
+      unsigned int to = s->adj[j];
+      if (to == G->first + v) {
+        continue;
+      }
+      G->adj[k++] = to;
+      if (to < G->first || to >= G->first + G->n) {
+        ghosts[n_ghosts++] = to;
+      }
+    }
+    G->xadj[v + 1] = k;
+    if (k - G->xadj[v] > G->max_degree) {
+      G->max_degree = k - G->xadj[v];
+    }
+  }
+  qsort(ghosts, n_ghosts, sizeof(unsigned int), compare_uints);
+  G->n_ghosts = 0;
+  for (unsigned long j = 0; j < n_ghosts; j++) {
+    if (j == 0 || ghosts[j] != ghosts[j - 1]) {
+      ghosts[G->n_ghosts++] = ghosts[j];
+    }
+  }
+  G->ghost_gid = ghosts;
+  for (unsigned long j = 0; j < k; j++) {
+    unsigned int to = G->adj[j];
+    G->adj[j] = to >= G->first && to < G->first + G->n ? to - G->first
+                                                       : ghost_index(G, to);
+  }
+
+  /* the ghosts are symmetric: an owned vertex is sent to the owner of each
+   * of its ghost neighbours, once per rank */
+  G->send_offsets = calloc(G->size + 1, sizeof(int));
+  int *last = malloc(G->size * sizeof(int));
+  if (G->send_offsets == NULL || last == NULL) {
+    printf("Error allocating the send lists!\n");
+    free(last);
+    return 0;
+  }
+  for (int pass = 0; pass < 2; pass++) {
+    for (int p = 0; p < G->size; p++) {
+      last[p] = -1;
+    }
+    for (unsigned int v = 0; v < G->n; v++) {
+      for (unsigned long j = G->xadj[v]; j < G->xadj[v + 1]; j++) {
+        if (G->adj[j] < G->n) {
+          continue;
+        }
+        int p = owner(G, G->ghost_gid[G->adj[j] - G->n]);
+        if (last[p] != v) {
+          last[p] = v;
+          if (pass == 0) {
+            G->send_offsets[p + 1]++;
+          } else {
+            G->send_vertices[G->send_offsets[p]++] = v;
+          }
+        }
+      }
+    }
+    if (pass == 0) {
+      for (int p = 0; p < G->size; p++) {
+        G->send_offsets[p + 1] += G->send_offsets[p];
+      }
+      /* one spare slot, for the ranks that send nothing */
+      G->send_vertices =
+          malloc((G->send_offsets[G->size] + 1) * sizeof(unsigned int));
+      if (G->send_vertices == NULL) {
+        printf("Error allocating the send lists!\n");
+        free(last);
+        return 0;
+      }
+    }
+  }
+  /* the second pass moved every offset to the start of the next rank */
+  for (int p = G->size; p > 0; p--) {
+    G->send_offsets[p] = G->send_offsets[p - 1];
+  }
+  G->send_offsets[0] = 0;
+  free(last);
+  return 1;
+}
+
+/* Sends the colors of the owned vertices colored in this superstep to the
+ * ranks that have them as ghosts, and updates the ghosts' colors with the
+ * ones received, all in a single all-to-all exchange. A vertex that isn't one
+ * of our ghosts can only come from a file whose adjacency lists aren't
+ * symmetric, and is ignored. Returns 0 if the receive buffer couldn't grow.
+ */
+static int exchange_colors(DistGraph G, unsigned int *colors,
+                            unsigned char *changed, exchange_t *x) {
+  unsigned int k = 0;
+  for (int p = 0; p < G->size; p++) {
+    x->send_displs[p] = k;
+    for (int j = G->send_offsets[p]; j < G->send_offsets[p + 1]; j++) {
+      unsigned int v = G->send_vertices[j];
+      if (changed[v]) {
+        x->send_buffer[k++] = G->first + v;
+        x->send_buffer[k++] = colors[v];
+      }
+    }
+    x->send_counts[p] = k - x->send_displs[p];
+  }
+  MPI_Alltoall(x->send_counts, 1, MPI_INT, x->recv_counts, 1, MPI_INT,
+               G->comm);
+  k = 0;
+  for (int p = 0; p < G->size; p++) {
+    x->recv_displs[p] = k;
+    k += x->recv_counts[p];
+  }
+  if (!grow((void **)&x->recv_buffer, &x->recv_capacity, k,
+            sizeof(unsigned int))) {
+    return 0;
+  }
+  MPI_Alltoallv(x->send_buffer, x->send_counts, x->send_displs, MPI_UNSIGNED,
+                x->recv_buffer, x->recv_counts, x->recv_displs, MPI_UNSIGNED,
+                G->comm);
+  for (unsigned int j = 0; j < k; j += 2) {
+    unsigned int u = ghost_index(G, x->recv_buffer[j]);
+    if (u >= G->n) {
+      colors[u] = x->recv_buffer[j + 1];
+    }
+  }
+  return 1;
+}
+
+/* of two adjacent vertices with the same color, the one with the lower weight
+ * (or index, between equal weights) gives up its color */
+static int loses(unsigned long long seed, unsigned int gid, unsigned int other) {
+  unsigned int w = UTIL_hash_random(seed, gid);
+  unsigned int w_other = UTIL_hash_random(seed, other);
+  return w < w_other || (w == w_other && gid < other);
+}
+
+/* EXPOSED FUNCTIONS */
+
+/* Loads the slice of the METIS file owned by the calling rank, every rank of
+ * comm parsing only the lines in its share of the file's bytes, so that no
+ * rank ever holds the whole graph. The vertices are block distributed by the
+ * lines each rank parsed, which balances the edges rather than the vertices.
+ * Collective: returns NULL on every rank if any of them failed.
+ */
+DistGraph DIST_load_metis(char *filename, MPI_Comm comm) {
+  DistGraph G = calloc(1, sizeof(struct dist_graph));
+  if (G == NULL) {
+    printf("Error allocating the distributed graph!\n");
+  }
+  if (!all_ok(comm, G != NULL)) {
+    free(G);
+    return NULL;
+  }
+  G->comm = comm;
+  MPI_Comm_rank(comm, &G->rank);
+  MPI_Comm_size(comm, &G->size);
+
+  char *dot = strrchr(filename, '.');
+  FILE *fp = NULL;
+  if (dot == NULL || strcmp(dot, ".graph")) {
+    if (G->rank == 0) {
+      printf("Only METIS (.graph) files can be distributed: %s\n", filename);
+    }
+  } else {
+    fp = fopen(filename, "r");
+    if (fp == NULL && G->rank == 0) {
+      printf("Error opening file %s\n", filename);
+    }
+  }
+  slice_t s;
+  memset(&s, 0, sizeof(slice_t));
+  unsigned int fmt, ncon;
+  int ok = fp != NULL && parse_slice(fp, G, &fmt, &ncon, &s);
+  if (fp != NULL) {
+    fclose(fp);
+  }
+  if (!all_ok(comm, ok)) {
+    free(s.xadj);
+    free(s.adj);
+    DIST_free(G);
+    return NULL;
+  }
+
+  /* the vertices parsed by the previous ranks give the first owned one, the
+   * last rank also owns the vertices without a line (if any) */
+  unsigned long lines = s.lines, first = 0;
+  MPI_Exscan(&lines, &first, 1, MPI_UNSIGNED_LONG, MPI_SUM, comm);
+  if (G->rank == 0) {
+    first = 0;
+  }
+  G->first = first < G->V ? first : G->V;
+  G->vertex_first = malloc((G->size + 1) * sizeof(unsigned int));
+  ok = G->vertex_first != NULL;
+  if (ok) {
+    MPI_Allgather(&G->first, 1, MPI_UNSIGNED, G->vertex_first, 1,
+                  MPI_UNSIGNED, comm);
+    G->vertex_first[G->size] = G->V;
+    G->n = G->vertex_first[G->rank + 1] - G->first;
+    /* lines past the V-th are dropped, missing ones are isolated vertices */
+    ok = grow((void **)&s.xadj, &s.lines_capacity, (unsigned long)G->n + 1,
+              sizeof(unsigned long));
+    for (unsigned long v = s.lines; ok && v < G->n; v++) {
+      s.xadj[v + 1] = s.xadj[v];
+    }
+  }
+  ok = ok && index_ghosts(G, &s);
+  free(s.xadj);
+  free(s.adj);
+  if (!all_ok(comm, ok)) {
+    DIST_free(G);
+    return NULL;
+  }
+  unsigned long local_edges = G->xadj[G->n];
+  MPI_Allreduce(&local_edges, &G->E, 1, MPI_UNSIGNED_LONG, MPI_SUM, comm);
+  G->E /= 2;  // every edge is listed by both its vertices
+  return G;
+}
+
+void DIST_free(DistGraph G) {
+  if (G == NULL) {
+    return;
+  }
+  free(G->vertex_first);
+  free(G->xadj);
+  free(G->adj);
+  free(G->ghost_gid);
+  free(G->send_offsets);
+  free(G->send_vertices);
+  free(G);
+}
+
+unsigned int DIST_get_vertex_count(DistGraph G) { return G->V; }
+
+unsigned long DIST_get_edge_count(DistGraph G) { return G->E; }
+
+unsigned int DIST_get_local_count(DistGraph G) { return G->n; }
+
+unsigned int DIST_get_ghost_count(DistGraph G) { return G->n_ghosts; }
+
+/* Colors the graph speculatively, in supersteps. In each superstep every rank
+ * colors its next vertices with the first color not used by their neighbours
+ * (in index order, or by descending degree with DIST_LDF), as if it were
+ * alone, until superstep of them are on the boundary, then the new colors of
+ * those are exchanged with the neighbouring ranks. Two adjacent vertices of
+ * different ranks may have taken the same color in the same superstep (a
+ * later one sees the color already): the one that loses (see loses()) is
+ * colored again after the rank's other vertices, until no rank has vertices
+ * left. Smaller supersteps mean fewer conflicts but more exchanges.
+ * Collective: returns the colors of the owned vertices followed by the
+ * ghosts' ones, or NULL on every rank if any of them failed.
+ */
+unsigned int *DIST_color(DistGraph G, DistOrder order, unsigned int superstep,
+                         unsigned long long seed, DistReport *report) {
+  memset(report, 0, sizeof(DistReport));
+  unsigned int *colors = calloc((unsigned long)G->n + G->n_ghosts + 1,
+                                sizeof(unsigned int));
+  unsigned int *to_color = malloc(((unsigned long)G->n + 1) *
+                                  sizeof(unsigned int));
+  unsigned int *degree = malloc(((unsigned long)G->n + 1) *
+                                sizeof(unsigned int));
+  unsigned int *step = malloc(((unsigned long)superstep + 1) *
+                              sizeof(unsigned int));
+  unsigned char *boundary = calloc((unsigned long)G->n + 1, 1);
+  unsigned char *changed = calloc((unsigned long)G->n + 1, 1);
+  int *neighbours_colors = malloc((G->max_degree + 1) * sizeof(int));
+  exchange_t x;
+  /* a (vertex, color) pair per sent vertex, plus a spare pair for the ranks
+   * that send nothing */
+  x.send_buffer = malloc(2 * ((unsigned long)G->send_offsets[G->size] + 1) *
+                         sizeof(unsigned int));
+  x.recv_buffer = NULL;  // grown as needed by exchange_colors()
+  x.recv_capacity = 0;
+  x.send_counts = malloc(4 * G->size * sizeof(int));
+  int ok = colors != NULL && to_color != NULL && degree != NULL &&
+           step != NULL && boundary != NULL && changed != NULL &&
+           neighbours_colors != NULL && x.send_buffer != NULL &&
+           x.send_counts != NULL;
+  if (!ok) {
+    printf("Error allocating the coloring buffers!\n");
+  }
+  if (!all_ok(G->comm, ok)) {
+    free(colors);
+    colors = NULL;
+  } else {
+    x.send_displs = x.send_counts + G->size;
+    x.recv_counts = x.send_counts + 2 * G->size;
+    x.recv_displs = x.send_counts + 3 * G->size;
+
+    for (unsigned int v = 0; v < G->n; v++) {
+      to_color[v] = v;
+      degree[v] = G->xadj[v + 1] - G->xadj[v];
+      for (unsigned long e = G->xadj[v]; e < G->xadj[v + 1]; e++) {
+        boundary[v] |= G->adj[e] >= G->n;
+      }
+    }
+    if (order == DIST_LDF) {
+      /* sorted in ascending order, so reverse it */
+      UTIL_stable_qsort_values_by_keys(degree, to_color, G->n);
+      for (unsigned int i = 0, j = G->n; i + 1 < j; i++, j--) {
+        unsigned int tmp = to_color[i];
+        to_color[i] = to_color[j - 1];
+        to_color[j - 1] = tmp;
+      }
+    }
+
+    /* to_color is a circular queue: the vertices that lose a conflict are
+     * put back at its end */
+    unsigned int head = 0, count = G->n;
+    unsigned long local[2], global[2];  // vertices left, and recolored
+    do {
+      report->rounds++;
+      unsigned int n_step = 0;
+      while (count > 0 && n_step < superstep) {
+        unsigned int v = to_color[head];
+        head = head + 1 < G->n ? head + 1 : 0;
+        count--;
+        unsigned int j = 0;
+        for (unsigned long e = G->xadj[v]; e < G->xadj[v + 1]; e++) {
+          neighbours_colors[j++] = colors[G->adj[e]];
+        }
+        colors[v] = UTIL_smallest_missing_number(neighbours_colors, j);
+        if (boundary[v]) {
+          step[n_step++] = v;
+          changed[v] = 1;
+        }
+      }
+
+      double start = MPI_Wtime();
+      if (!exchange_colors(G, colors, changed, &x)) {
+        MPI_Abort(G->comm, 4);  // the other ranks are already exchanging
+      }
+      report->exchange_time += MPI_Wtime() - start;
+
+      local[1] = 0;
+      for (unsigned int i = 0; i < n_step; i++) {
+        unsigned int v = step[i];
+        changed[v] = 0;
+        for (unsigned long e = G->xadj[v]; e < G->xadj[v + 1]; e++) {
+          unsigned int u = G->adj[e];
+          if (u >= G->n && colors[u] == colors[v] &&
+              loses(seed, G->first + v, G->ghost_gid[u - G->n])) {
+            to_color[(head + count++) % G->n] = v;
+            local[1]++;
+            break;
+          }
+        }
+      }
+      local[0] = count;
+      MPI_Allreduce(local, global, 2, MPI_UNSIGNED_LONG, MPI_SUM, G->comm);
+      report->recolored += global[1];
+    } while (global[0] > 0);
+
+    /* count the colors, and the edges left with the same color (once, from
+     * the endpoint with the lower global index) */
+    unsigned int local_colors = 0;
+    unsigned long local_conflicts = 0;
+    for (unsigned int v = 0; v < G->n; v++) {
+      if (colors[v] > local_colors) {
+        local_colors = colors[v];
+      }
+      for (unsigned long e = G->xadj[v]; e < G->xadj[v + 1]; e++) {
+        unsigned int u = G->adj[e];
+        unsigned int gid = u < G->n ? G->first + u : G->ghost_gid[u - G->n];
+        local_conflicts += colors[u] == colors[v] && G->first + v < gid;
+      }
+    }
+    MPI_Allreduce(&local_colors, &report->colors_used, 1, MPI_UNSIGNED,
+                  MPI_MAX, G->comm);
+    MPI_Allreduce(&local_conflicts, &report->conflicts, 1, MPI_UNSIGNED_LONG,
+                  MPI_SUM, G->comm);
+    double exchange_time = report->exchange_time;
+    MPI_Allreduce(&exchange_time, &report->exchange_time, 1, MPI_DOUBLE,
+                  MPI_MAX, G->comm);
+  }
+  free(to_color);
+  free(degree);
+  free(step);
+  free(boundary);
+  free(changed);
+  free(neighbours_colors);
+  free(x.send_buffer);
+  free(x.recv_buffer);
+  free(x.send_counts);
+  return colors;
+}
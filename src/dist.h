@@ -0,0 +1,40 @@
+#ifndef DIST_H
+#define DIST_H
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+/* The slice of a graph owned by one MPI rank: a contiguous range of vertices,
+ * their adjacency lists, and the ghosts (the vertices owned by other ranks
+ * that are adjacent to the owned ones). Vertices are referred to by local
+ * indexes: [0, n) are the owned ones, [n, n + n_ghosts) the ghosts.
+ */
+typedef struct dist_graph *DistGraph;
+
+typedef enum { DIST_GREEDY, DIST_LDF } DistOrder;
+
+/* boundary vertices colored by each rank between two exchanges */
+#define DIST_DEFAULT_SUPERSTEP 1000
+
+typedef struct dist_report {
+  unsigned int rounds;       // supersteps, i.e. exchanges
+  unsigned long recolored;  // speculative colorings undone, on every rank
+  unsigned int colors_used;
+  unsigned long conflicts;  // edges left with the same color at the end
+  double exchange_time;     // spent exchanging the ghosts' colors (max)
+} DistReport;
+
+DistGraph DIST_load_metis(char *filename, MPI_Comm comm);
+void DIST_free(DistGraph G);
+unsigned int DIST_get_vertex_count(DistGraph G);
+unsigned long DIST_get_edge_count(DistGraph G);
+unsigned int DIST_get_local_count(DistGraph G);
+unsigned int DIST_get_ghost_count(DistGraph G);
+unsigned int *DIST_color(DistGraph G, DistOrder order, unsigned int superstep,
+                         unsigned long long seed, DistReport *report);
+
+#endif
@@ -0,0 +1,434 @@
+#include "gen.h"
+
+#define N_GENERATORS 6
+typedef enum {
+  rgg,
+  erdos_renyi,
+  barabasi_albert,
+  rmat,
+  grid2d,
+  grid3d
+} generator;
+static const char *generators[N_GENERATORS] = {"rgg",  "er",     "ba",
+                                        "rmat", "grid2d", "grid3d"};
+/* default value of the optional parameter of each generator (see
+ * GEN_generate), 0 if it has none */
+static const double default_params[N_GENERATORS] = {0.55, 16, 8, 16, 0, 0};
+
+/* R-MAT quadrant probabilities, the ones used by Graph500 (d = 0.05) */
+#define RMAT_A 0.57
+#define RMAT_B 0.19
+#define RMAT_C 0.19
+
+typedef struct gen_struct {
+  generator type;
+  unsigned int scale;
+  unsigned int V;
+  double param;
+  unsigned long long seed;
+  unsigned long from, to;  // the edge slots, vertices or rows of cells of
+                           // this thread
+  Edge *edges;  // shared by all threads, except for rgg where each thread
+                // has its own
+  unsigned long n_edges, capacity;  // only used by rgg
+  double *x, *y;                    // rgg points
+  unsigned int *cell;               // cell of each rgg point
+  unsigned long *cell_start;        // rgg points sorted by cell
+  unsigned int cells_per_side;
+  double radius;
+  unsigned int failed;
+} gen_t;
+
+/* UTILITY FUNCTIONS */
+
+static generator generator_str_to_enum(char *generator_str) {
+  for (int i = 0; i < N_GENERATORS; i++) {
+    if (!strcmp(generator_str, generators[i])) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* uniform in [0, 1), like every random number here it only depends on the
+ * seed and on the counter, so threads don't share any generator state */
+static double uniform(unsigned long long seed, unsigned long long counter) {
+  return UTIL_hash_random(seed, counter) / 4294967296.0;
+}
+
+static unsigned long long random64(unsigned long long seed,
+                                   unsigned long long counter) {
+  return ((unsigned long long)UTIL_hash_random(seed, 2 * counter) << 32) |
+         UTIL_hash_random(seed, 2 * counter + 1);
+}
+
+/* a bijection of [0, 2^scale) used to spread the R-MAT hubs, which would
+ * otherwise all have the smallest indexes */
+static unsigned int scramble(unsigned int v, unsigned int scale,
+                             unsigned long long seed) {
+  unsigned int mask = (1u << scale) - 1;
+  v = (v * 0x9E3779B1u + (unsigned int)seed) & mask;
+  v ^= v >> ((scale + 1) / 2);
+  return (v * 0x85EBCA6Bu) & mask;
+}
+
+/* the k-th edge of each generator, where the endpoints are the same for the
+ * edge slots that don't correspond to an edge (e.g. on the border of grids) */
+static void edge_slot(gen_t *g, unsigned long k, Edge *e) {
+  unsigned int V = g->V;
+  switch (g->type) {
+    case erdos_renyi:
+      e->from = random64(g->seed, 2 * k) % V;
+      e->to = random64(g->seed, 2 * k + 1) % V;
+      break;
+    case rmat: {
+      unsigned int u = 0, v = 0;
+      for (unsigned int l = 0; l < g->scale; l++) {
+        double r = uniform(g->seed, (unsigned long long)k * g->scale + l);
+        u = (u << 1) | (r >= RMAT_A + RMAT_B);
+        v = (v << 1) | ((r >= RMAT_A && r < RMAT_A + RMAT_B) ||
+                        r >= RMAT_A + RMAT_B + RMAT_C);
+      }
+      e->from = scramble(u, g->scale, g->seed);
+      e->to = scramble(v, g->scale, g->seed);
+      break;
+    }
+    case barabasi_albert: {
+      /* vertex s adds its m edges after all the previous ones: the target of
+       * edge k is an endpoint of a uniformly chosen previous edge, which makes
+       * it proportional to the degree. If it's the target of another edge,
+       * that one is resolved first (Sanders and Schulz), so that every edge
+       * can be computed independently */
+      unsigned int m = (unsigned int)g->param;
+      unsigned long cur = k;
+      e->from = k / m;
+      e->to = 0;
+      while (cur > 0) {
+        unsigned long x = random64(g->seed, cur) % (2 * cur);
+        if (x % 2 == 0) {
+          e->to = (x / 2) / m;
+          break;
+        }
+        cur = x / 2;
+      }
+      break;
+    }
+    case grid2d: {
+      unsigned int cols = 1u << (g->scale - g->scale / 2);
+      unsigned int v = k / 2;
+      e->from = e->to = v;
+      if (k % 2 == 0 && v % cols + 1 < cols) {
+        e->to = v + 1;
+      } else if (k % 2 == 1 && v + cols < V) {
+        e->to = v + cols;
+      }
+      break;
+    }
+    case grid3d: {
+      unsigned int nx = 1u << (g->scale / 3);
+      unsigned int ny = 1u << ((g->scale - g->scale / 3) / 2);
+      unsigned int v = k / 3;
+      e->from = e->to = v;
+      if (k % 3 == 0 && v % nx + 1 < nx) {
+        e->to = v + 1;
+      } else if (k % 3 == 1 && (v / nx) % ny + 1 < ny) {
+        e->to = v + nx;
+      } else if (k % 3 == 2 && v + nx * ny < V) {
+        e->to = v + nx * ny;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+static void generate_slots(void *par) {
+  gen_t *tD = (gen_t *)par;
+  for (unsigned long k = tD->from; k < tD->to; k++) {
+    edge_slot(tD, k, &tD->edges[k]);
+  }
+}
+
+static void rgg_generate_points(void *par) {
+  gen_t *tD = (gen_t *)par;
+  unsigned int g = tD->cells_per_side;
+  for (unsigned long i = tD->from; i < tD->to; i++) {
+    tD->x[i] = uniform(tD->seed, 2 * i);
+    tD->y[i] = uniform(tD->seed, 2 * i + 1);
+    unsigned int cx = tD->x[i] * g, cy = tD->y[i] * g;
+    tD->cell[i] = (cy < g ? cy : g - 1) * g + (cx < g ? cx : g - 1);
+  }
+}
+
+static int rgg_add_edge(gen_t *tD, unsigned int from, unsigned int to) {
+  if (tD->n_edges == tD->capacity) {
+    unsigned long capacity = tD->capacity ? 2 * tD->capacity : 1024;
+    Edge *tmp = realloc(tD->edges, capacity * sizeof(Edge));
+    if (tmp == NULL) {
+      fprintf(stderr, "Error reallocating edges array!\n");
+      tD->failed = 1;
+      return 0;
+    }
+    tD->edges = tmp;
+    tD->capacity = capacity;
+  }
+  tD->edges[tD->n_edges].from = from;
+  tD->edges[tD->n_edges].to = to;
+  tD->n_edges++;
+  return 1;
+}
+
+/* each thread connects the points of a range of rows of cells. Since the
+ * cells are at least as large as the radius, only the adjacent cells need to
+ * be checked, and only half of them so that every edge is found once */
+static void rgg_connect_points(void *par) {
+  gen_t *tD = (gen_t *)par;
+  unsigned int g = tD->cells_per_side;
+  double r2 = tD->radius * tD->radius;
+  const int dx[4] = {1, -1, 0, 1}, dy[4] = {0, 1, 1, 1};
+  tD->edges = NULL;
+  tD->n_edges = tD->capacity = 0;
+  tD->failed = 0;
+
+  for (unsigned int cy = tD->from; cy < tD->to; cy++) {
+    for (unsigned int cx = 0; cx < g; cx++) {
+      unsigned long c = (unsigned long)cy * g + cx;
+      for (unsigned long i = tD->cell_start[c]; i < tD->cell_start[c + 1];
+           i++) {
+        for (unsigned long j = i + 1; j < tD->cell_start[c + 1]; j++) {
+          double ddx = tD->x[i] - tD->x[j], ddy = tD->y[i] - tD->y[j];
+          if (ddx * ddx + ddy * ddy <= r2 && !rgg_add_edge(tD, i, j)) {
+            return;
+          }
+        }
+        for (int n = 0; n < 4; n++) {
+          int nx = cx + dx[n], ny = cy + dy[n];
+          if (nx < 0 || nx >= g || ny >= g) {
+            continue;
+          }
+          unsigned long d = (unsigned long)ny * g + nx;
+          for (unsigned long j = tD->cell_start[d]; j < tD->cell_start[d + 1];
+               j++) {
+            double ddx = tD->x[i] - tD->x[j], ddy = tD->y[i] - tD->y[j];
+            if (ddx * ddx + ddy * ddy <= r2 && !rgg_add_edge(tD, i, j)) {
+              return;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+/* splits [0, total) among n_threads copies of base, each running worker on
+ * its own range. Returns the copies, freed by the caller */
+static gen_t *run_threads(gen_t *base, unsigned int n_threads,
+                          unsigned long total, void (*worker)(void *)) {
+  gen_t *par = malloc(n_threads * sizeof(gen_t));
+  pthread_t *threads = malloc(n_threads * sizeof(pthread_t));
+  if (par == NULL || threads == NULL) {
+    fprintf(stderr, "Error allocating generator threads!\n");
+    free(par);
+    free(threads);
+    return NULL;
+  }
+  for (unsigned int i = 0; i < n_threads; i++) {
+    par[i] = *base;
+    par[i].from = total * i / n_threads;
+    par[i].to = total * (i + 1) / n_threads;
+    pthread_create(&threads[i], NULL, (void *)worker, (void *)&par[i]);
+  }
+  for (unsigned int i = 0; i < n_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  return par;
+}
+
+/* random geometric graph: 2^scale points in the unit square, connected if
+ * closer than param * sqrt(ln(n) / n), like the rgg_n_2_* graphs. Vertices
+ * are numbered by cell, so that close points have close indexes */
+static Graph generate_rgg(gen_t *base, unsigned int n_threads) {
+  unsigned int V = base->V;
+  base->radius = base->param * sqrt(log(V) / V);
+  base->cells_per_side = base->radius < 1 ? 1 / base->radius : 1;
+  unsigned int g = base->cells_per_side;
+  unsigned long n_cells = (unsigned long)g * g;
+
+  base->x = malloc(V * sizeof(double));
+  base->y = malloc(V * sizeof(double));
+  base->cell = malloc(V * sizeof(unsigned int));
+  base->cell_start = calloc(n_cells + 1, sizeof(unsigned long));
+  double *sorted_x = malloc(V * sizeof(double));
+  double *sorted_y = malloc(V * sizeof(double));
+  if (base->x == NULL || base->y == NULL || base->cell == NULL ||
+      base->cell_start == NULL || sorted_x == NULL || sorted_y == NULL) {
+    fprintf(stderr, "Error allocating rgg points!\n");
+    free(base->x);
+    free(base->y);
+    free(base->cell);
+    free(base->cell_start);
+    free(sorted_x);
+    free(sorted_y);
+    return NULL;
+  }
+
+  gen_t *par = run_threads(base, n_threads, V, rgg_generate_points);
+  if (par == NULL) {
+    free(base->x);
+    free(base->y);
+    free(base->cell);
+    free(base->cell_start);
+    free(sorted_x);
+    free(sorted_y);
+    return NULL;
+  }
+  free(par);
+
+  /* sort the points by cell (counting sort) */
+  for (unsigned int i = 0; i < V; i++) {
+    base->cell_start[base->cell[i] + 1]++;
+  }
+  for (unsigned long c = 0; c < n_cells; c++) {
+    base->cell_start[c + 1] += base->cell_start[c];
+  }
+  for (unsigned int i = 0; i < V; i++) {
+    unsigned long pos = base->cell_start[base->cell[i]]++;
+    sorted_x[pos] = base->x[i];
+    sorted_y[pos] = base->y[i];
+  }
+  for (unsigned long c = n_cells; c > 0; c--) {
+    base->cell_start[c] = base->cell_start[c - 1];
+  }
+  base->cell_start[0] = 0;
+  free(base->x);
+  free(base->y);
+  free(base->cell);
+  base->x = sorted_x;
+  base->y = sorted_y;
+
+  Graph G = NULL;
+  par = run_threads(base, n_threads, g, rgg_connect_points);
+  if (par != NULL) {
+    /* merge the edges found by each thread */
+    unsigned long n_edges = 0;
+    unsigned int failed = 0;
+    for (unsigned int i = 0; i < n_threads; i++) {
+      n_edges += par[i].n_edges;
+      failed |= par[i].failed;
+    }
+    /* one spare edge, so that a graph without edges still gets a buffer */
+    Edge *edges = failed ? NULL : malloc((n_edges + 1) * sizeof(Edge));
+    if (edges != NULL) {
+      n_edges = 0;
+      for (unsigned int i = 0; i < n_threads; i++) {
+        memcpy(edges + n_edges, par[i].edges, par[i].n_edges * sizeof(Edge));
+        n_edges += par[i].n_edges;
+      }
+    } else if (!failed) {
+      fprintf(stderr, "Error allocating edges array!\n");
+    }
+    for (unsigned int i = 0; i < n_threads; i++) {
+      free(par[i].edges);
+    }
+    free(par);
+    if (edges != NULL) {
+      G = GRAPH_build_from_edges(V, edges, n_edges, n_threads);
+      free(edges);
+    }
+  }
+  free(base->x);
+  free(base->y);
+  free(base->cell_start);
+  return G;
+}
+
+/* EXPOSED FUNCTIONS */
+
+int GEN_is_spec(char *name) {
+  return !strncmp(name, GEN_PREFIX, strlen(GEN_PREFIX));
+}
+
+/* Generates the graph described by spec, "gen:<type>:<scale>[:<param>]",
+ * with 2^scale vertices, using n_threads threads. Types are:
+ * - rgg: random geometric graph, param is the radius factor (default 0.55)
+ * - er: Erdos-Renyi G(n, m), param is the average degree (default 16)
+ * - ba: Barabasi-Albert, param is the number of edges added by each vertex
+ *   (default 8)
+ * - rmat: R-MAT/Kronecker with the Graph500 probabilities, param is the
+ *   average degree (default 16)
+ * - grid2d, grid3d: 2D and 3D grids with (almost) equal sides
+ * Duplicated edges and self loops are dropped, so the average degree of er,
+ * ba and rmat graphs is slightly lower than requested. The same spec and
+ * seed always give the same graph, regardless of n_threads.
+ */
+Graph GEN_generate(char *spec, unsigned int n_threads,
+                   unsigned long long seed) {
+  char type_str[16];
+  unsigned int scale;
+  double param = 0;
+  int n = sscanf(spec, GEN_PREFIX "%15[^:]:%u:%lf", type_str, &scale, &param);
+  if (n < 2) {
+    fprintf(stderr, "Error: invalid graph specification %s\n", spec);
+    return NULL;
+  }
+  generator type = generator_str_to_enum(type_str);
+  if (type == -1) {
+    fprintf(stderr, "Error: unknown graph generator %s\n", type_str);
+    return NULL;
+  }
+  if (scale < 1 || scale > GEN_MAX_SCALE) {
+    fprintf(stderr, "Error: the scale of %s must be between 1 and %d\n", spec,
+           GEN_MAX_SCALE);
+    return NULL;
+  }
+  if (n < 3) {
+    param = default_params[type];
+  } else if (param <= 0 || (type == barabasi_albert && param < 1)) {
+    fprintf(stderr, "Error: invalid parameter for %s\n", spec);
+    return NULL;
+  }
+
+  gen_t base;
+  memset(&base, 0, sizeof(gen_t));
+  base.type = type;
+  base.scale = scale;
+  base.V = 1u << scale;
+  base.param = param;
+  base.seed = seed;
+  if (type == rgg) {
+    return generate_rgg(&base, n_threads);
+  }
+
+  unsigned long n_slots;
+  switch (type) {
+    case erdos_renyi:
+    case rmat:
+      n_slots = (unsigned long)(base.V * param / 2);
+      break;
+    case barabasi_albert:
+      n_slots = (unsigned long)base.V * (unsigned int)param;
+      break;
+    case grid2d:
+      n_slots = 2 * (unsigned long)base.V;
+      break;
+    default:
+      n_slots = 3 * (unsigned long)base.V;
+      break;
+  }
+  /* one spare slot, as a small average degree can round n_slots to 0 */
+  base.edges = malloc((n_slots + 1) * sizeof(Edge));
+  if (base.edges == NULL) {
+    fprintf(stderr, "Error allocating edges array!\n");
+    return NULL;
+  }
+  gen_t *par = run_threads(&base, n_threads, n_slots, generate_slots);
+  Graph G = NULL;
+  if (par != NULL) {
+    free(par);
+    G = GRAPH_build_from_edges(base.V, base.edges, n_slots, n_threads);
+  }
+  free(base.edges);
+  return G;
+}
@@ -0,0 +1,23 @@
+#ifndef GEN_H
+#define GEN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "graph.h"
+#include "util.h"
+
+/* generated graphs are specified as "gen:<type>:<scale>[:<param>]", with
+ * 2^scale vertices (see GEN_generate) */
+#define GEN_PREFIX "gen:"
+#define GEN_DEFAULT_SEED 1
+#define GEN_MAX_SCALE 30
+
+int GEN_is_spec(char *name);
+Graph GEN_generate(char *spec, unsigned int n_threads,
+                   unsigned long long seed);
+
+#endif
@@ -1,15 +1,36 @@
+#define _GNU_SOURCE  // for pthread_setaffinity_np
 #include "graph.h"
 
-#define N_COLORING_METHODS 6
-typedef enum {
-  seq_greedy,
-  seq_ldf,
-  par_jp,
-  par_ldf,
-  par_ldf_plus
-} coloring_method;
-const char *coloring_methods[N_COLORING_METHODS] = {
-    "seq_greedy", "seq_ldf", "par_jp", "par_ldf", "par_ldf_plus"};
+#include <math.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/sysinfo.h>
+
+#include "calib.h"
+
+const char *GRAPH_coloring_methods[GRAPH_N_COLORING_METHODS] = {
+    "seq_greedy",    "seq_ldf",          "par_jp",
+    "par_ldf",       "par_ldf_plus",     "par_hybrid",
+    "par_partition", "seq_dense_greedy", "seq_dense_dsatur",
+    "auto"};
+
+/* in the hybrid method, a vertex is a hub if its degree is more than
+ * HUB_STDDEVS standard deviations above the average degree */
+#define HUB_STDDEVS 3
+
+/* a thread waiting for a color backs off for up to 2^SPIN_YIELD_AFTER pauses,
+ * then yields the CPU at each check */
+#define SPIN_YIELD_AFTER 10
+
+/* the most nodes of the lists allocated together, when on huge pages */
+#define NODE_BLOCK_SIZE (UTIL_HUGE_PAGE_SIZE / sizeof(struct node))
+
+/* set by GRAPH_set_huge_pages() for the graphs and contexts created later */
+static int use_huge_pages = 0;
+
+/* set by GRAPH_set_dense_thresholds() */
+static unsigned int dense_max_vertices = GRAPH_DENSE_MAX_VERTICES;
+static double dense_min_density = GRAPH_DENSE_MIN_DENSITY;
 
 typedef struct node *link;
 
@@ -18,33 +39,119 @@ struct node {
   link next;
 };
 
+typedef struct node_block {
+  struct node *nodes;
+  unsigned long size, used;
+  struct node_block *next;
+} NodeBlock;
+
 struct graph {
   unsigned int V, E;
   link *ladj;
   link z;
   unsigned int *degree;
+  unsigned int max_degree;
   unsigned int *color;
+  GraphFeatures features;
+  unsigned int has_features;
+  unsigned int huge_pages;  // arrays and nodes allocated by UTIL_alloc_huge()
+  NodeBlock *blocks;        // where the nodes are, if on huge pages
+  unsigned long hugetlb_bytes, transparent_bytes;
 };
 
 typedef struct param_struct {
   Graph G;
-  unsigned int index;
+  unsigned int *color;  // the coloring being computed
   unsigned int *weights;
   unsigned int *vertexes;
-  pthread_mutex_t *lock;
+  unsigned int *degree_count;
+  double *degree_sum;
+  unsigned int *hub_count;
+  unsigned int *hubs;
+  int *neighbours_colors;           // one row for each thread, each one with
+  unsigned int neighbours_stride;   // room for the largest neighbourhood
+  unsigned long long *rows;  // bit matrix of the dense methods
+  unsigned long long seed;
+  pthread_barrier_t barrier;
   unsigned int n_threads;
+  ColoringProfile *profile;
+  double phase_start;  // only used by thread 0
 } param_t;
 
-/* UTILITY FUNCTIONS */
+typedef struct worker_struct {
+  ColoringContext ctx;
+  unsigned int index;
+  HwCounters counters;  // opened by the worker, they only count its thread
+  unsigned int counters_opened;  // tried to, they may not be available
+} worker_t;
 
-static coloring_method method_str_to_enum(char *coloring_method_str) {
-  for (unsigned int i = 0; i < N_COLORING_METHODS; i++) {
-    if (!strcmp(coloring_method_str, coloring_methods[i])) {
-      return i;
-    }
-  }
-  return -1;
-}
+/* A coloring context keeps its worker threads and scratch buffers alive
+ * between colorings. Workers sleep on job_ready until job_id changes, run the
+ * job with their own index, and the last one to finish signals job_done.
+ */
+struct coloring_context {
+  unsigned int n_threads;
+  pthread_t *threads;
+  worker_t *workers;
+  pthread_mutex_t lock;
+  pthread_cond_t job_ready;
+  pthread_cond_t job_done;
+  unsigned long job_id;
+  unsigned int finished;  // workers done with the current job
+  unsigned int shutdown;
+  void (*job)(param_t *, unsigned int);
+  param_t par;  // shared by the workers running the current job
+  unsigned int scratch_vertices;  // the vertices the arrays below can hold
+  unsigned int *weights;
+  unsigned int *vertexes;
+  unsigned int *colors;  // used when the caller doesn't supply a buffer
+  unsigned long degree_count_size;
+  unsigned int *degree_count;
+  unsigned long neighbours_size;
+  int *neighbours_colors;
+  unsigned long dense_size;  // words of the dense methods' bit matrices
+  unsigned long long *dense_words;
+  double *degree_sum;
+  unsigned int *hub_count;
+  ColoringProfile profile;  // phases' timings of the last coloring
+  unsigned int counting;    // workers read their hardware counters
+  HwCounters counters;      // the workers' counts summed over the last coloring
+  unsigned int huge_pages;  // scratch arrays allocated by UTIL_alloc_huge()
+  unsigned int pinned;      // the caller is pinned to CPU 0 while coloring
+};
+
+typedef struct validation_struct {
+  Graph G;
+  unsigned int *colors;
+  unsigned int from, to;
+  unsigned int stop_after;
+  ColoringReport *report;
+  pthread_mutex_t *lock;
+  unsigned int *class_size;
+  unsigned int max_color;
+  unsigned long conflicts;
+  unsigned long uncolored;
+  unsigned int failed;
+} validation_t;
+
+typedef struct build_struct {
+  Graph G;
+  unsigned long *offsets;    // neighbours of vertex v are in
+  unsigned int *neighbours;  // neighbours[offsets[v]..offsets[v + 1])
+  unsigned int from, to;
+  struct node *nodes;  // if not NULL, the node of neighbours[i] is nodes[i]
+  unsigned int max_degree;
+  unsigned long edges;
+  unsigned int failed;
+} build_t;
+
+typedef struct sort_adjacency_struct {
+  Graph G;
+  unsigned int from, to;
+  unsigned int failed;
+} sort_adjacency_t;
+
+/* UTILITY FUNCTIONS */
 
 static link LINK_new(int index, link next) {
   link x = malloc(sizeof *x);
@@ -57,191 +164,777 @@ static link LINK_new(int index, link next) {
   return x;
 }
 
+/* allocates one of the arrays of G, on huge pages if G uses them */
+static void *graph_alloc(Graph G, unsigned long size) {
+  if (!G->huge_pages) {
+    return malloc(size);
+  }
+  PageKind kind;
+  void *p = UTIL_alloc_huge(size, &kind);
+  if (p != NULL && kind == UTIL_PAGES_HUGETLB) {
+    G->hugetlb_bytes += size;
+  } else if (p != NULL && kind == UTIL_PAGES_TRANSPARENT) {
+    G->transparent_bytes += size;
+  }
+  return p;
+}
+
+static void graph_free_array(Graph G, void *p, unsigned long size) {
+  if (G->huge_pages) {
+    UTIL_free_huge(p, size);
+  } else {
+    free(p);
+  }
+}
+
+/* adds a block of size nodes to G, returning NULL if it couldn't */
+static NodeBlock *node_block_new(Graph G, unsigned long size) {
+  NodeBlock *b = malloc(sizeof(NodeBlock));
+  if (b == NULL) {
+    return NULL;
+  }
+  b->nodes = graph_alloc(G, size * sizeof(struct node));
+  if (b->nodes == NULL) {
+    free(b);
+    return NULL;
+  }
+  b->size = size;
+  b->used = 0;
+  b->next = G->blocks;
+  G->blocks = b;
+  return b;
+}
+
+/* like LINK_new(), but takes the node from the blocks of G if it's on huge
+ * pages, so that neighbouring nodes are also close in memory */
+static link GRAPH_link_new(Graph G, int index, link next) {
+  if (!G->huge_pages) {
+    return LINK_new(index, next);
+  }
+  NodeBlock *b = G->blocks;
+  if (b == NULL || b->used == b->size) {
+    /* start from a node per vertex, doubling up to a huge page per block */
+    unsigned long size = b == NULL ? G->V + 1 : 2 * b->size;
+    b = node_block_new(G, size < NODE_BLOCK_SIZE ? size : NODE_BLOCK_SIZE);
+    if (b == NULL) {
+      fprintf(stderr, "Error while allocating a link\n");
+      return NULL;
+    }
+  }
+  link x = &b->nodes[b->used++];
+  x->index = index;
+  x->next = next;
+  return x;
+}
+
 static link EDGE_insert(Graph G, int from, int to) {
-  link new = LINK_new(to, G->ladj[from]);
+  link new = GRAPH_link_new(G, to, G->ladj[from]);
   if (new == NULL) {
     fprintf(stderr, "Error while inserting an edge\n");
     return NULL;
   }
   G->ladj[from] = new;
   G->degree[from]++;
+  if (G->degree[from] > G->max_degree) {
+    G->max_degree = G->degree[from];
+  }
   G->E++;
   return G->ladj[from];
 }
 
+static int compare_uints(const void *a, const void *b) {
+  unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+  return (x > y) - (x < y);
+}
+
+/* each thread builds the adjacency lists of a contiguous range of vertices,
+ * sorting their neighbours to drop the duplicated edges. The lists are built
+ * here instead of through EDGE_insert() since that updates the edge count and
+ * the maximum degree of the whole graph */
+static void build_range(void *par) {
+  build_t *tD = (build_t *)par;
+  Graph G = tD->G;
+  tD->max_degree = 0;
+  tD->edges = 0;
+  tD->failed = 0;
+  for (unsigned int v = tD->from; v < tD->to; v++) {
+    unsigned int *first = tD->neighbours + tD->offsets[v];
+    unsigned long n = tD->offsets[v + 1] - tD->offsets[v];
+    qsort(first, n, sizeof(unsigned int), compare_uints);
+    /* insert from the end, so that the list is in ascending order */
+    for (unsigned long j = n; j-- > 0;) {
+      if (j + 1 < n && first[j] == first[j + 1]) {
+        continue;
+      }
+      link new = tD->nodes != NULL ? &tD->nodes[tD->offsets[v] + j]
+                                    : LINK_new(first[j], G->ladj[v]);
+      if (new == NULL) {
+        tD->failed = 1;
+        return;
+      }
+      new->index = first[j];
+      new->next = G->ladj[v];
+      G->ladj[v] = new;
+      G->degree[v]++;
+    }
+    if (G->degree[v] > tD->max_degree) {
+      tD->max_degree = G->degree[v];
+    }
+    tD->edges += G->degree[v];
+  }
+}
+
+/* neighbours with a higher degree first, and with a higher index among the
+ * ones with the same degree, i.e. the order of LDF's priorities */
+static int compare_priority(const void *a, const void *b, void *degree) {
+  unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+  unsigned int dx = ((unsigned int *)degree)[x];
+  unsigned int dy = ((unsigned int *)degree)[y];
+  if (dx != dy) {
+    return (dx < dy) - (dx > dy);
+  }
+  return (x < y) - (x > y);
+}
+
+/* each thread sorts the adjacency lists of a contiguous range of vertices,
+ * rewriting the indexes of the existing nodes instead of relinking them */
+static void sort_adjacency_range(void *par) {
+  sort_adjacency_t *tD = (sort_adjacency_t *)par;
+  Graph G = tD->G;
+  /* one spare slot, so that a graph without edges still gets a buffer */
+  unsigned int *neighbours =
+      malloc(((unsigned long)G->max_degree + 1) * sizeof(unsigned int));
+  if (neighbours == NULL) {
+    tD->failed = 1;
+    return;
+  }
+  tD->failed = 0;
+  for (unsigned int v = tD->from; v < tD->to; v++) {
+    unsigned int j = 0;
+    for (link t = G->ladj[v]; t != G->z; t = t->next) {
+      neighbours[j++] = t->index;
+    }
+    qsort_r(neighbours, j, sizeof(unsigned int), compare_priority, G->degree);
+    j = 0;
+    for (link t = G->ladj[v]; t != G->z; t = t->next) {
+      t->index = neighbours[j++];
+    }
+  }
+  free(neighbours);
+}
+
+/* cheap statistics used to choose the coloring method, computed once */
+static void compute_features(Graph G) {
+  GraphFeatures *f = &G->features;
+  double sum = 0, sq_sum = 0;
+  for (unsigned int i = 0; i < G->V; i++) {
+    sum += G->degree[i];
+    sq_sum += (double)G->degree[i] * G->degree[i];
+  }
+  f->vertex_count = G->V;
+  f->edge_count = G->E;
+  f->max_degree = G->max_degree;
+  f->avg_degree = G->V ? sum / G->V : 0;
+  double variance = G->V ? sq_sum / G->V - f->avg_degree * f->avg_degree : 0;
+  f->degree_stddev = variance > 0 ? sqrt(variance) : 0;
+  f->degree_skew = f->avg_degree > 0 ? f->max_degree / f->avg_degree : 1;
+  G->has_features = 1;
+}
+
+/* PROFILING
+ * The phases are disjoint: every parallel method is made of the wake-up of the
+ * worker threads, the initialization (colors and weights), the sort (any
+ * ordering of the vertices by priority) and finally the coloring. Thread 0
+ * marks the end of each phase right after the barrier that closes it, while
+ * the end of the coloring is marked by the caller once every thread is done.
+ */
+static void profile_begin(ColoringProfile *p, unsigned int n_threads) {
+  ThreadProfile *threads = p->threads;
+  memset(p, 0, sizeof(ColoringProfile));
+  memset(threads, 0, n_threads * sizeof(ThreadProfile));
+  p->threads = threads;
+  p->n_threads = n_threads;
+}
+
+/* called by every thread right after a barrier */
+static void end_phase(param_t *tD, unsigned int index, double *phase_time) {
+  if (index == 0) {
+    double now = UTIL_get_time();
+    *phase_time += now - tD->phase_start;
+    tD->phase_start = now;
+  }
+}
+
+static void profile_end(ColoringProfile *p) {
+  for (unsigned int i = 0; i < p->n_threads; i++) {
+    if (p->threads[i].rounds > p->rounds) {
+      p->rounds = p->threads[i].rounds;
+    }
+  }
+}
+
+/* THREAD POOL */
+static void *worker_loop(void *arg) {
+  worker_t *w = (worker_t *)arg;
+  ColoringContext ctx = w->ctx;
+  unsigned long seen = 0;
+  pthread_mutex_lock(&ctx->lock);
+  for (;;) {
+    while (ctx->job_id == seen && !ctx->shutdown) {
+      pthread_cond_wait(&ctx->job_ready, &ctx->lock);
+    }
+    if (ctx->shutdown) {
+      break;
+    }
+    seen = ctx->job_id;
+    unsigned int counting = ctx->counting && w->index < ctx->par.n_threads;
+    pthread_mutex_unlock(&ctx->lock);
+    if (counting && !w->counters_opened) {
+      w->counters_opened = 1;
+      PROF_counters_open(&w->counters);  // counts stay -1 if it fails
+    }
+    if (w->index < ctx->par.n_threads) {
+      if (counting) {
+        PROF_counters_start(&w->counters);
+      }
+      ctx->job(&ctx->par, w->index);
+      if (counting) {
+        PROF_counters_stop(&w->counters);
+      }
+    }
+    pthread_mutex_lock(&ctx->lock);
+    if (counting) {
+      PROF_counters_add(&ctx->counters, &w->counters);
+    }
+    if (++ctx->finished == ctx->n_threads) {
+      pthread_cond_signal(&ctx->job_done);
+    }
+  }
+  pthread_mutex_unlock(&ctx->lock);
+  return NULL;
+}
+
+/* wakes up the workers, the first n_threads of them running job with the
+ * context's param struct, and waits for all of them to finish */
+static void run_job(ColoringContext ctx, unsigned int n_threads,
+                    void (*job)(param_t *, unsigned int)) {
+  param_t *par = &ctx->par;
+  ColoringProfile *p = par->profile;
+  par->n_threads = n_threads;
+  pthread_barrier_init(&par->barrier, NULL, n_threads);
+
+  double start = UTIL_get_time();
+  par->phase_start = start;
+  pthread_mutex_lock(&ctx->lock);
+  ctx->job = job;
+  ctx->finished = 0;
+  ctx->job_id++;
+  pthread_cond_broadcast(&ctx->job_ready);
+  p->spawn_time = UTIL_get_time() - start;
+  while (ctx->finished < ctx->n_threads) {
+    pthread_cond_wait(&ctx->job_done, &ctx->lock);
+  }
+  pthread_mutex_unlock(&ctx->lock);
+  p->color_time = UTIL_get_time() - par->phase_start;
+  pthread_barrier_destroy(&par->barrier);
+  profile_end(p);
+}
+
+/* grows one of the scratch arrays of the context from old_size to size
+ * bytes, without keeping its content if it's on huge pages */
+static int grow(ColoringContext ctx, void **buffer, unsigned long old_size,
+                unsigned long size) {
+  void *tmp;
+  if (ctx->huge_pages) {
+    PageKind kind;
+    tmp = UTIL_alloc_huge(size, &kind);
+    if (tmp != NULL) {
+      UTIL_free_huge(*buffer, old_size);
+    }
+  } else {
+    tmp = realloc(*buffer, size);
+  }
+  if (tmp == NULL) {
+    fprintf(stderr, "Error allocating scratch buffers!\n");
+    return 0;
+  }
+  *buffer = tmp;
+  return 1;
+}
+
+/* grows the scratch buffers of the context, if needed, to color G */
+static int reserve_scratch(ColoringContext ctx, Graph G) {
+  /* weights, vertexes and colors share a single allocation */
+  if (G->V > ctx->scratch_vertices || ctx->weights == NULL) {
+    unsigned long old_row = (unsigned long)ctx->scratch_vertices + 1;
+    unsigned long row = (unsigned long)G->V + 1;
+    if (!grow(ctx, (void **)&ctx->weights, 3 * old_row * sizeof(unsigned int),
+              3 * row * sizeof(unsigned int))) {
+      return 0;
+    }
+    ctx->vertexes = ctx->weights + row;
+    ctx->colors = ctx->vertexes + row;
+    ctx->scratch_vertices = G->V;
+  }
+  /* one row of degree counters for each thread, used by the parallel sort */
+  unsigned long size = (unsigned long)ctx->n_threads * (G->max_degree + 1);
+  if (size > ctx->degree_count_size) {
+    if (!grow(ctx, (void **)&ctx->degree_count,
+              ctx->degree_count_size * sizeof(unsigned int),
+              size * sizeof(unsigned int))) {
+      return 0;
+    }
+    ctx->degree_count_size = size;
+  }
+  if (size > ctx->neighbours_size) {
+    if (!grow(ctx, (void **)&ctx->neighbours_colors,
+              ctx->neighbours_size * sizeof(int), size * sizeof(int))) {
+      return 0;
+    }
+    ctx->neighbours_size = size;
+  }
+  return 1;
+}
+
+/* words of a row of n bits */
+static unsigned long dense_row_words(unsigned long n) { return (n + 63) / 64; }
+
+/* grows the bit matrices used by the dense methods, if needed, to color G:
+ * the adjacency rows, two rows of vertices, and a row of colors for each
+ * vertex, with room for the max_degree + 1 colors a greedy coloring may use */
+static int reserve_dense(ColoringContext ctx, Graph G) {
+  unsigned long words = dense_row_words(G->V);
+  unsigned long size = ((unsigned long)G->V + 2) * words +
+                       G->V * dense_row_words(G->max_degree + 1);
+  if (size > ctx->dense_size) {
+    if (!grow(ctx, (void **)&ctx->dense_words,
+              ctx->dense_size * sizeof(unsigned long long),
+              size * sizeof(unsigned long long))) {
+      return 0;
+    }
+    ctx->dense_size = size;
+  }
+  ctx->par.rows = ctx->dense_words;
+  return 1;
+}
+
 /* COLORING ALGORITHMS */
 
 /* SEQUENTIAL GREEDY */
-unsigned int *color_sequential_greedy(Graph G) {
+static void color_sequential_greedy(param_t *tD) {
+  Graph G = tD->G;
+  unsigned int *color = tD->color;
   unsigned int n = G->V;
-  unsigned int *random_order = malloc(n * sizeof(unsigned int));
-  if (random_order == NULL) {
-    printf("Error allocating random order array!\n");
-    return NULL;
-  }
+  unsigned int *random_order = tD->vertexes;
+  int *neighbours_colors = tD->neighbours_colors;
+  ColoringProfile *p = tD->profile;
+  profile_begin(p, 1);
+  double start = UTIL_get_time();
   for (unsigned int i = 0; i < n; i++) {
-    G->color[i] = 0;
+    color[i] = 0;
     random_order[i] = i;
   }
-  UTIL_randomize_array(random_order, n);
+  double sort_start = UTIL_get_time();
+  UTIL_randomize_array(random_order, n, tD->seed);
+  double color_start = UTIL_get_time();
+  p->init_time = sort_start - start;
+  p->sort_time = color_start - sort_start;
   for (int i = 0; i < n; i++) {
     unsigned int ii = random_order[i];
 
-    int *neighbours_colors = malloc(G->degree[ii] * sizeof(int));
     unsigned int j = 0;
     for (link t = G->ladj[ii]; t != G->z; t = t->next) {
-      neighbours_colors[j++] = G->color[t->index];
+      neighbours_colors[j++] = color[t->index];
     }
 
-    G->color[ii] = UTIL_smallest_missing_number(neighbours_colors, G->degree[ii]);
-    free(neighbours_colors);
+    color[ii] = UTIL_smallest_missing_number(neighbours_colors, G->degree[ii]);
   }
-  free(random_order);
-  return G->color;
+  p->color_time = UTIL_get_time() - color_start;
+  p->threads[0].busy_time = p->color_time;
+  p->threads[0].rounds = p->rounds = 1;
 }
 
 /* SEQUENTIAL LDF */
-unsigned int *color_sequential_ldf(Graph G) {
+static void color_sequential_ldf(param_t *tD) {
+  Graph G = tD->G;
+  unsigned int *color = tD->color;
   unsigned int n = G->V;
-  unsigned int *degree = malloc(n * sizeof(unsigned int));
-  if (degree == NULL) {
-    printf("Error allocating degrees array!\n");
-    return NULL;
-  }
-  unsigned int *vertex = malloc(n * sizeof(unsigned int));
-  if (vertex == NULL) {
-    printf("Error allocating vertex array!\n");
-    return NULL;
-  }
+  unsigned int *degree = tD->weights;
+  unsigned int *vertex = tD->vertexes;
+  int *neighbours_colors = tD->neighbours_colors;
+  ColoringProfile *p = tD->profile;
+  profile_begin(p, 1);
+  double start = UTIL_get_time();
   for (unsigned int i = 0; i < n; i++) {
-    G->color[i] = 0;
+    color[i] = 0;
     degree[i] = G->degree[i];
     vertex[i] = i;
   }
+  double sort_start = UTIL_get_time();
   UTIL_heapsort_values_by_keys(n, degree, vertex);
+  double color_start = UTIL_get_time();
+  p->init_time = sort_start - start;
+  p->sort_time = color_start - sort_start;
   for (int i = n - 1; i >= 0; i--) {
     unsigned int ii = vertex[i];  // heap sort will sorts degrees in ascending
                                   // order, so we access them backwards
-    int *neighbours_colors = malloc(degree[i] * sizeof(int));
-    if (neighbours_colors == NULL) {
-      printf("Error allocating neighbours_colors array!\n");
-    }
     unsigned int j = 0;
     for (link t = G->ladj[ii]; t != G->z; t = t->next) {
-      neighbours_colors[j++] = G->color[t->index];
+      neighbours_colors[j++] = color[t->index];
     }
 
-    G->color[ii] = UTIL_smallest_missing_number(neighbours_colors, degree[i]);
-    free(neighbours_colors);
+    color[ii] = UTIL_smallest_missing_number(neighbours_colors, degree[i]);
+  }
+  p->color_time = UTIL_get_time() - color_start;
+  p->threads[0].busy_time = p->color_time;
+  p->threads[0].rounds = p->rounds = 1;
+}
+
+/* DENSE METHODS
+ * On small dense graphs, the adjacency lists are replaced by a bit matrix
+ * with a row of V bits for each vertex, so that a whole word of neighbours is
+ * handled by a single AND. The loops over the words of a row are kept free
+ * of dependencies between iterations, so that they're vectorized at -O3.
+ */
+
+/* Clears the matrix and sets, in the row of each vertex v, the bits of its
+ * neighbours. The row and the bit of vertex v are position[v], or v itself if
+ * position is NULL */
+static void dense_build_rows(Graph G, unsigned int *position,
+                             unsigned long long *rows, unsigned long words) {
+  memset(rows, 0, (unsigned long)G->V * words * sizeof(unsigned long long));
+  for (unsigned int v = 0; v < G->V; v++) {
+    unsigned long long *row =
+        rows + (position != NULL ? position[v] : v) * words;
+    for (link t = G->ladj[v]; t != G->z; t = t->next) {
+      unsigned int bit = position != NULL ? position[t->index] : t->index;
+      row[bit / 64] |= 1ULL << (bit % 64);
+    }
+  }
+}
+
+/* sets the first n bits of set, and clears the others */
+static void dense_fill(unsigned long long *set, unsigned long n) {
+  unsigned long words = dense_row_words(n);
+  for (unsigned long w = 0; w < words; w++) {
+    set[w] = ~0ULL;
+  }
+  if (n % 64) {
+    set[words - 1] = (1ULL << (n % 64)) - 1;
+  }
+}
+
+/* SEQUENTIAL DENSE GREEDY
+ * Builds the color classes one at a time: class c takes the uncolored
+ * vertices, in random order, that aren't adjacent to a vertex already in the
+ * class, which is what first-fit gives to each vertex when the vertices are
+ * colored in the same order. The rows are indexed by position in the order,
+ * so that the next vertex of a class is the lowest bit set among the
+ * candidates, and adding it to the class removes its neighbours from the
+ * candidates with an AND NOT of its row. With the same seed, the coloring is
+ * the same as the sequential greedy one.
+ */
+static void color_dense_greedy(param_t *tD) {
+  Graph G = tD->G;
+  unsigned int *color = tD->color;
+  unsigned int n = G->V;
+  unsigned int *order = tD->vertexes;
+  unsigned int *position = tD->weights;
+  unsigned long words = dense_row_words(n);
+  unsigned long long *rows = tD->rows;
+  unsigned long long *uncolored = rows + (unsigned long)n * words;
+  unsigned long long *candidates = uncolored + words;
+  ColoringProfile *p = tD->profile;
+  profile_begin(p, 1);
+  double start = UTIL_get_time();
+  for (unsigned int i = 0; i < n; i++) {
+    color[i] = 0;
+    order[i] = i;
+  }
+  UTIL_randomize_array(order, n, tD->seed);
+  double sort_start = UTIL_get_time();
+  for (unsigned int i = 0; i < n; i++) {
+    position[order[i]] = i;
+  }
+  dense_build_rows(G, position, rows, words);
+  dense_fill(uncolored, n);
+  double color_start = UTIL_get_time();
+  p->init_time = sort_start - start;
+  p->sort_time = color_start - sort_start;
+
+  unsigned long first = 0;  // the words before it have no uncolored vertex
+  for (unsigned int c = 1; first < words; c++) {
+    memcpy(candidates + first, uncolored + first,
+           (words - first) * sizeof(unsigned long long));
+    for (unsigned long w = first; w < words; w++) {
+      while (candidates[w] != 0) {
+        unsigned int i = w * 64 + __builtin_ctzll(candidates[w]);
+        unsigned long long *row = rows + (unsigned long)i * words;
+        color[order[i]] = c;
+        uncolored[w] &= ~(1ULL << (i % 64));
+        candidates[w] &= ~(1ULL << (i % 64));
+        for (unsigned long k = w; k < words; k++) {
+          candidates[k] &= ~row[k];
+        }
+      }
+    }
+    while (first < words && uncolored[first] == 0) {
+      first++;
+    }
+  }
+  p->color_time = UTIL_get_time() - color_start;
+  p->threads[0].busy_time = p->color_time;
+  p->threads[0].rounds = p->rounds = 1;
+}
+
+/* SEQUENTIAL DENSE DSATUR
+ * Colors next the uncolored vertex with the most distinct colors among its
+ * neighbours (its saturation), breaking ties by the most uncolored neighbours
+ * and then by the lowest index, with the smallest color none of its
+ * neighbours has. Each vertex keeps the colors of its neighbours as a row of
+ * bits, where the smallest missing color is the first zero bit, and the
+ * uncolored degrees start from the popcount of the adjacency rows.
+ */
+static void color_dense_dsatur(param_t *tD) {
+  Graph G = tD->G;
+  unsigned int *color = tD->color;
+  unsigned int n = G->V;
+  unsigned int *saturation = tD->weights;
+  unsigned int *uncolored_degree = tD->vertexes;
+  unsigned long words = dense_row_words(n);
+  unsigned long color_words = dense_row_words(G->max_degree + 1);
+  unsigned long long *rows = tD->rows;
+  unsigned long long *uncolored = rows + (unsigned long)n * words;
+  unsigned long long *neighbours_colors = uncolored + 2 * words;
+  ColoringProfile *p = tD->profile;
+  profile_begin(p, 1);
+  double start = UTIL_get_time();
+  dense_build_rows(G, NULL, rows, words);
+  dense_fill(uncolored, n);
+  memset(neighbours_colors, 0,
+         (unsigned long)n * color_words * sizeof(unsigned long long));
+  for (unsigned int v = 0; v < n; v++) {
+    unsigned long long *row = rows + (unsigned long)v * words;
+    unsigned int degree = 0;
+    for (unsigned long w = 0; w < words; w++) {
+      degree += __builtin_popcountll(row[w]);
+    }
+    color[v] = 0;
+    saturation[v] = 0;
+    uncolored_degree[v] = degree;
+  }
+  double color_start = UTIL_get_time();
+  p->init_time = color_start - start;
+
+  unsigned long first = 0;  // the words before it have no uncolored vertex
+  for (unsigned int colored = 0; colored < n; colored++) {
+    unsigned int v = n;
+    for (unsigned long w = first; w < words; w++) {
+      for (unsigned long long m = uncolored[w]; m != 0; m &= m - 1) {
+        unsigned int u = w * 64 + __builtin_ctzll(m);
+        if (v == n || saturation[u] > saturation[v] ||
+            (saturation[u] == saturation[v] &&
+             uncolored_degree[u] > uncolored_degree[v])) {
+          v = u;
+        }
+      }
+    }
+
+    /* fewer than max_degree + 1 bits are set, so a zero bit is found */
+    unsigned long long *forbidden =
+        neighbours_colors + (unsigned long)v * color_words;
+    unsigned long k = 0;
+    while (forbidden[k] == ~0ULL) {
+      k++;
+    }
+    unsigned int c = k * 64 + __builtin_ctzll(~forbidden[k]);
+    color[v] = c + 1;
+    uncolored[v / 64] &= ~(1ULL << (v % 64));
+
+    unsigned long long *row = rows + (unsigned long)v * words;
+    for (unsigned long w = first; w < words; w++) {
+      for (unsigned long long m = row[w] & uncolored[w]; m != 0; m &= m - 1) {
+        unsigned int u = w * 64 + __builtin_ctzll(m);
+        unsigned long long *f =
+            neighbours_colors + (unsigned long)u * color_words + c / 64;
+        uncolored_degree[u]--;
+        if (!(*f & (1ULL << (c % 64)))) {
+          *f |= 1ULL << (c % 64);
+          saturation[u]++;
+        }
+      }
+    }
+    while (first < words && uncolored[first] == 0) {
+      first++;
+    }
+  }
+  p->color_time = UTIL_get_time() - color_start;
+  p->threads[0].busy_time = p->color_time;
+  p->threads[0].rounds = p->rounds = 1;
+}
+
+/* SHARED COLORS
+ * In the parallel methods a thread reads the colors of vertices owned by
+ * other threads while they're being written. A color is published with a
+ * release store once it's final, and read with an acquire load, so that the
+ * compiler can't keep a stale color in a register (e.g. hoisting the load out
+ * of a busy-wait) and every thread sees either 0 or the final color. The
+ * colors written before a barrier, or only read by their own thread, are
+ * accessed as plain integers. On x86 both are plain moves.
+ */
+static inline unsigned int load_color(unsigned int *color, unsigned int v) {
+  return atomic_load_explicit((_Atomic unsigned int *)&color[v],
+                              memory_order_acquire);
+}
+
+static inline void store_color(unsigned int *color, unsigned int v,
+                               unsigned int c) {
+  atomic_store_explicit((_Atomic unsigned int *)&color[v], c,
+                        memory_order_release);
+}
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+/* Waits a bit longer at each call: 2^spins pause instructions, which keep the
+ * spinning core from flooding the memory bus, until SPIN_YIELD_AFTER calls
+ * after which the CPU is given up to another thread (e.g. the one we're
+ * waiting for, when there are more threads than CPUs) */
+static void spin_backoff(unsigned int *spins) {
+  if (*spins < SPIN_YIELD_AFTER) {
+    for (unsigned int i = 0; i < 1u << *spins; i++) {
+      cpu_relax();
+    }
+    (*spins)++;
+  } else {
+    sched_yield();
+  }
+}
+
+/* waits for vertex v to be colored by another thread, returning its color */
+static unsigned int wait_color(unsigned int *color, unsigned int v) {
+  unsigned int c, spins = 0;
+  while ((c = load_color(color, v)) == 0) {
+    spin_backoff(&spins);
+  }
+  return c;
+}
+
+/* PARALLEL INITIALIZATION
+ * Every thread resets the colors and generates the weights of a contiguous
+ * block of vertices (contiguous, so that threads don't write to the same cache
+ * lines), the weights only depend on the seed and on the vertex index.
+ */
+static void init_colors_and_weights(param_t *tD, unsigned int index) {
+  Graph G = tD->G;
+  unsigned int from = (unsigned long)G->V * index / tD->n_threads;
+  unsigned int to = (unsigned long)G->V * (index + 1) / tD->n_threads;
+  for (unsigned int i = from; i < to; i++) {
+    tD->color[i] = 0;
+    tD->weights[i] = UTIL_hash_random(tD->seed, i);
   }
-  free(vertex);
-  free(degree);
-  return G->color;
 }
 
 /* PARALLEL JP*/
-void jp_color_vertex(Graph G, unsigned int index, unsigned int n_threads,
-                     unsigned int *weights) {
+static void jp_color_vertex(param_t *tD, unsigned int index) {
+  Graph G = tD->G;
+  unsigned int *color = tD->color;
+  unsigned int *weights = tD->weights;
+  unsigned int n_threads = tD->n_threads;
+  int *neighbours_colors =
+      tD->neighbours_colors + (unsigned long)index * tD->neighbours_stride;
+  ThreadProfile *tp = &tD->profile->threads[index];
   unsigned int n = G->V;
-  int uncolored = n / n_threads;
-  if (n % n_threads && (index < n % n_threads)) {
-    uncolored++;  // this is needed to manage graphs with a vertex count that is
-                  // not a multiple of the number of threads
+  double start = UTIL_get_time();
+  int uncolored = 0;
+  for (int i = index; i < n; i += n_threads) {
+    uncolored += color[i] == 0;  // some vertices may have been colored
+                                 // already (e.g. the hubs in par_hybrid)
   }
+  unsigned int spins = 0;
   while (uncolored > 0) {
+    /* a round that colors nothing is time spent waiting for other threads */
+    double round_start = UTIL_get_time();
+    int round_uncolored = uncolored;
+    tp->rounds++;
     for (int i = index; i < n; i += n_threads) {
-      if (G->color[i] == 0) {
-        int *neighbours_colors = malloc(G->degree[i] * sizeof(int));
+      if (color[i] == 0) {
         unsigned int has_highest_number = 1;
         unsigned int j = 0;
         for (link t = G->ladj[i]; t != G->z; t = t->next) {
-          if (G->color[t->index] == 0 &&
+          unsigned int c = load_color(color, t->index);
+          if (c == 0 &&
               (weights[t->index] > weights[i] ||
                (weights[t->index] == weights[i] && t->index > i))) {
             has_highest_number = 0;
             break;
           } else {
-            neighbours_colors[j++] = G->color[t->index];
+            neighbours_colors[j++] = c;
           }
         }
 
         if (has_highest_number) {
-          G->color[i] =
-              UTIL_smallest_missing_number(neighbours_colors, G->degree[i]);
+          store_color(color, i,
+                      UTIL_smallest_missing_number(neighbours_colors,
+                                                   G->degree[i]));
           uncolored--;
         }
-        free(neighbours_colors);
       }
     }
+    if (uncolored == round_uncolored) {
+      tp->spin_time += UTIL_get_time() - round_start;
+      spin_backoff(&spins);
+    } else {
+      spins = 0;
+    }
   }
+  tp->busy_time = UTIL_get_time() - start;
 }
 
-void jp_color_vertex_wrapper(void *par) {
-  param_t *tD = (param_t *)par;
-  unsigned int index = tD->index; // read the index
-  pthread_mutex_unlock(tD->lock); // then unlock the mutex
-  jp_color_vertex(tD->G, index, tD->n_threads, tD->weights);
+static void jp_color_vertex_wrapper(param_t *tD, unsigned int index) {
+  init_colors_and_weights(tD, index);
+  pthread_barrier_wait(&tD->barrier); // wait for every vertex to be initialized
+  end_phase(tD, index, &tD->profile->init_time);
+  jp_color_vertex(tD, index);
 }
 
-unsigned int *color_parallel_jp(Graph G, unsigned int n_threads) {
-  unsigned int n = G->V;
-  unsigned int *weights = malloc(n * sizeof(unsigned int));
-  if (weights == NULL) {
-    printf("Error allocating weights array!\n");
-    return NULL;
-  }
-  for (unsigned int i = 0; i < n; i++) {
-    G->color[i] = 0;
-    weights[i] = rand();
-  }
-  pthread_mutex_t mutex;
-
-  param_t *par = malloc(sizeof(param_t));
-  par->G = G;
-  par->n_threads = n_threads;
-  par->weights = weights;
-  par->lock = &mutex;
-  pthread_t *threads = malloc(n_threads * sizeof(pthread_t));
-  /* since we use a single param struct for all threads, we need a mutex to
-   to make sure the value of par->index is NOT modified until the thread has
-   read it
-  */
-  pthread_mutex_init(&mutex, NULL);
-
-  for (unsigned int i = 0; i < n_threads; i++) {
-    pthread_mutex_lock(&mutex); // lock the mutex or wait until it is unlocked
-    par->index = i; // assign i
-    pthread_create(&threads[i], NULL, (void *)&jp_color_vertex_wrapper,
-                   (void *)par);
-  }
-
-  for (int i = 0; i < n_threads; i++) {
-    pthread_join(threads[i], NULL);
-  }
-
-  free(par);
-  free(weights);
-  free(threads);
-  pthread_mutex_destroy(&mutex);
-  return G->color;
+static void color_parallel_jp(ColoringContext ctx, unsigned int n_threads) {
+  profile_begin(ctx->par.profile, n_threads);
+  run_job(ctx, n_threads, jp_color_vertex_wrapper);
 }
 
 /* PARALLEL LDF */
-void ldf_color_vertex(Graph G, unsigned int index, unsigned int n_threads,
-                      unsigned int *weights) {
+static void ldf_color_vertex(param_t *tD, unsigned int index) {
+  Graph G = tD->G;
+  unsigned int *color = tD->color;
+  unsigned int *weights = tD->weights;
+  unsigned int n_threads = tD->n_threads;
+  int *neighbours_colors =
+      tD->neighbours_colors + (unsigned long)index * tD->neighbours_stride;
+  ThreadProfile *tp = &tD->profile->threads[index];
   unsigned int n = G->V;
+  double start = UTIL_get_time();
   int uncolored = n / n_threads;
   if (n % n_threads && (index < n % n_threads)) {
     uncolored++;
   }
+  unsigned int spins = 0;
   while (uncolored > 0) {
+    double round_start = UTIL_get_time();
+    int round_uncolored = uncolored;
+    tp->rounds++;
     for (int i = index; i < n; i += n_threads) {
-      if (G->color[i] == 0) {
-        int *neighbours_colors = malloc(G->degree[i] * sizeof(int));
+      if (color[i] == 0) {
         unsigned int has_highest_number = 1;
         unsigned int j = 0;
         for (link t = G->ladj[i]; t != G->z; t = t->next) {
-          if (G->color[t->index] == 0 &&
+          unsigned int c = load_color(color, t->index);
+          if (c == 0 &&
               (G->degree[t->index] > G->degree[i] ||
                (G->degree[t->index] == G->degree[i] &&
                 weights[t->index] > weights[i]) ||
@@ -250,143 +943,501 @@ void ldf_color_vertex(Graph G, unsigned int index, unsigned int n_threads,
             has_highest_number = 0;
             break;
           } else {
-            neighbours_colors[j++] = G->color[t->index];
+            neighbours_colors[j++] = c;
           }
         }
 
         if (has_highest_number) {
-          G->color[i] =
-              UTIL_smallest_missing_number(neighbours_colors, G->degree[i]);
+          store_color(color, i,
+                      UTIL_smallest_missing_number(neighbours_colors,
+                                                   G->degree[i]));
           uncolored--;
         }
-        free(neighbours_colors);
       }
     }
+    if (uncolored == round_uncolored) {
+      tp->spin_time += UTIL_get_time() - round_start;
+      spin_backoff(&spins);
+    } else {
+      spins = 0;
+    }
   }
+  tp->busy_time = UTIL_get_time() - start;
 }
 
-void ldf_color_vertex_wrapper(void *par) {
-  param_t *tD = (param_t *)par;
-  unsigned int index = tD->index;
-  pthread_mutex_unlock(tD->lock);
-  ldf_color_vertex(tD->G, index, tD->n_threads, tD->weights);
+static void ldf_color_vertex_wrapper(param_t *tD, unsigned int index) {
+  init_colors_and_weights(tD, index);
+  pthread_barrier_wait(&tD->barrier);
+  end_phase(tD, index, &tD->profile->init_time);
+  ldf_color_vertex(tD, index);
 }
 
-unsigned int *color_parallel_ldf(Graph G, unsigned int n_threads) {
+static void color_parallel_ldf(ColoringContext ctx, unsigned int n_threads) {
+  profile_begin(ctx->par.profile, n_threads);
+  run_job(ctx, n_threads, ldf_color_vertex_wrapper);
+}
+
+/* PARALLEL LDF PLUS */
+static void ldf_plus_color_vertex(param_t *tD, unsigned int index) {
+  Graph G = tD->G;
+  unsigned int *color = tD->color;
+  unsigned int *sorted_vertices = tD->vertexes;
+  unsigned int n_threads = tD->n_threads;
+  int *neighbours_colors =
+      tD->neighbours_colors + (unsigned long)index * tD->neighbours_stride;
+  ThreadProfile *tp = &tD->profile->threads[index];
   unsigned int n = G->V;
-  unsigned int *weights = malloc(n * sizeof(unsigned int));
-  if (weights == NULL) {
-    printf("Error allocating weights array!\n");
-    return NULL;
+  double start = UTIL_get_time();
+  tp->rounds = 1;
+  for (int i = n - 1 - index; i >= 0; i -= n_threads) {
+    unsigned int ii = sorted_vertices[i];
+
+    unsigned int j = 0;
+    for (link t = G->ladj[ii]; t != G->z; t = t->next) {
+      unsigned int c = load_color(color, t->index);
+      if (c == 0 &&
+          (G->degree[t->index] > G->degree[ii] ||
+           (G->degree[t->index] == G->degree[ii] && t->index > ii))) {
+        /* only take the time when we actually have to wait */
+        double wait_start = UTIL_get_time();
+        c = wait_color(color, t->index);
+        tp->spin_time += UTIL_get_time() - wait_start;
+      }
+
+      neighbours_colors[j++] = c;
+    }
+    store_color(color, ii,
+                UTIL_smallest_missing_number(neighbours_colors,
+                                             G->degree[ii]));
   }
-  for (unsigned int i = 0; i < n; i++) {
-    G->color[i] = 0;
-    weights[i] = rand();
+  tp->busy_time = UTIL_get_time() - start;
+}
+
+/* Sorts the vertices by degree (and by index, for vertices with the same
+ * degree) with a parallel counting sort: every thread counts the degrees of a
+ * contiguous block of vertices, then thread 0 turns the counts into the
+ * starting offsets of each (degree, thread) pair and finally every thread
+ * scatters its own block. The result is the same as a stable sort by degree.
+ */
+static void ldf_plus_sort_vertices(param_t *tD, unsigned int index) {
+  Graph G = tD->G;
+  unsigned int n_threads = tD->n_threads;
+  unsigned int n_degrees = G->max_degree + 1;
+  unsigned int from = (unsigned long)G->V * index / n_threads;
+  unsigned int to = (unsigned long)G->V * (index + 1) / n_threads;
+  unsigned int *count = tD->degree_count + (unsigned long)index * n_degrees;
+
+  memset(count, 0, n_degrees * sizeof(unsigned int));
+  for (unsigned int i = from; i < to; i++) {
+    tD->color[i] = 0;
+    count[G->degree[i]]++;
   }
-  pthread_mutex_t mutex;
+  pthread_barrier_wait(&tD->barrier);
+  end_phase(tD, index, &tD->profile->init_time);
 
-  param_t *par = malloc(sizeof(param_t));
-  par->G = G;
-  par->n_threads = n_threads;
-  par->weights = weights;
-  par->lock = &mutex;
-  pthread_t *threads = malloc(n_threads * sizeof(pthread_t));
-  pthread_mutex_init(&mutex, NULL);
+  if (index == 0) {
+    unsigned int offset = 0;
+    for (unsigned int d = 0; d < n_degrees; d++) {
+      for (unsigned int t = 0; t < n_threads; t++) {
+        unsigned int *c = tD->degree_count + (unsigned long)t * n_degrees + d;
+        unsigned int tmp = *c;
+        *c = offset;
+        offset += tmp;
+      }
+    }
+  }
+  pthread_barrier_wait(&tD->barrier);
 
-  for (unsigned int i = 0; i < n_threads; i++) {
-    pthread_mutex_lock(&mutex);
-    par->index = i;
-    pthread_create(&threads[i], NULL, (void *)&ldf_color_vertex_wrapper,
-                   (void *)par);
+  for (unsigned int i = from; i < to; i++) {
+    tD->vertexes[count[G->degree[i]]++] = i;
   }
+  pthread_barrier_wait(&tD->barrier);
+  end_phase(tD, index, &tD->profile->sort_time);
+}
 
-  for (int i = 0; i < n_threads; i++) {
-    pthread_join(threads[i], NULL);
+static void ldf_plus_color_vertex_wrapper(param_t *tD, unsigned int index) {
+  ldf_plus_sort_vertices(tD, index);
+  ldf_plus_color_vertex(tD, index);
+}
+
+static void color_parallel_ldf_plus(ColoringContext ctx,
+                                    unsigned int n_threads) {
+  profile_begin(ctx->par.profile, n_threads);
+  run_job(ctx, n_threads, ldf_plus_color_vertex_wrapper);
+}
+
+/* PARALLEL HYBRID
+ * The hubs (the vertices with a degree way above the average) are colored
+ * first, sequentially and in LDF order, by thread 0. Then all the threads
+ * color the remaining vertices with JP, where the hubs are already colored
+ * and so can't make the long chains of waiting vertices that they would
+ * cause in JP/LDF.
+ */
+static void hybrid_select_hubs(param_t *tD, unsigned int index) {
+  Graph G = tD->G;
+  unsigned int n_threads = tD->n_threads;
+  unsigned int from = (unsigned long)G->V * index / n_threads;
+  unsigned int to = (unsigned long)G->V * (index + 1) / n_threads;
+
+  /* reset colors, generate weights, and sum the degrees of the block */
+  double sum = 0, sq_sum = 0;
+  for (unsigned int i = from; i < to; i++) {
+    tD->color[i] = 0;
+    tD->weights[i] = UTIL_hash_random(tD->seed, i);
+    sum += G->degree[i];
+    sq_sum += (double)G->degree[i] * G->degree[i];
   }
+  tD->degree_sum[2 * index] = sum;
+  tD->degree_sum[2 * index + 1] = sq_sum;
+  pthread_barrier_wait(&tD->barrier);
+  end_phase(tD, index, &tD->profile->init_time);
+
+  /* every thread computes the same threshold from the partial sums */
+  sum = sq_sum = 0;
+  for (unsigned int t = 0; t < n_threads; t++) {
+    sum += tD->degree_sum[2 * t];
+    sq_sum += tD->degree_sum[2 * t + 1];
+  }
+  double mean = G->V ? sum / G->V : 0;
+  double variance = G->V ? sq_sum / G->V - mean * mean : 0;
+  double threshold = mean + HUB_STDDEVS * sqrt(variance > 0 ? variance : 0);
+  unsigned int count = 0;
+  for (unsigned int i = from; i < to; i++) {
+    count += G->degree[i] > threshold;
+  }
+  tD->hub_count[index] = count;
+  pthread_barrier_wait(&tD->barrier);
+
+  /* thread 0 turns the counts into offsets in the hubs array */
+  if (index == 0) {
+    unsigned int offset = 0;
+    for (unsigned int t = 0; t < n_threads; t++) {
+      unsigned int tmp = tD->hub_count[t];
+      tD->hub_count[t] = offset;
+      offset += tmp;
+    }
+    tD->hub_count[n_threads] = offset;
+  }
+  pthread_barrier_wait(&tD->barrier);
+
+  unsigned int offset = tD->hub_count[index];
+  for (unsigned int i = from; i < to; i++) {
+    if (G->degree[i] > threshold) {
+      tD->hubs[offset++] = i;
+    }
+  }
+  pthread_barrier_wait(&tD->barrier);
+  end_phase(tD, index, &tD->profile->sort_time);
+}
+
+static void hybrid_color_hubs(param_t *tD) {
+  Graph G = tD->G;
+  unsigned int *hubs = tD->hubs;
+  unsigned int k = tD->hub_count[tD->n_threads];
+  int *neighbours_colors = tD->neighbours_colors;  // thread 0's row
+  unsigned int *degree = malloc((k + 1) * sizeof(unsigned int));
+  if (degree == NULL) {
+    fprintf(stderr, "Error allocating degrees array!\n");
+    return;  // the hubs will simply be colored by JP
+  }
+  for (unsigned int i = 0; i < k; i++) {
+    degree[i] = G->degree[hubs[i]];
+  }
+  UTIL_stable_qsort_values_by_keys(degree, hubs, k);
+  for (int i = k - 1; i >= 0; i--) {
+    unsigned int ii = hubs[i];  // sorted in ascending order, so we access
+                                // them backwards
+    unsigned int j = 0;
+    for (link t = G->ladj[ii]; t != G->z; t = t->next) {
+      neighbours_colors[j++] = tD->color[t->index];
+    }
+    tD->color[ii] = UTIL_smallest_missing_number(neighbours_colors, degree[i]);
+  }
+  free(degree);
+}
+
+static void hybrid_color_vertex_wrapper(param_t *tD, unsigned int index) {
+  hybrid_select_hubs(tD, index);
+  if (index == 0) {
+    hybrid_color_hubs(tD);
+  }
+  pthread_barrier_wait(&tD->barrier);  // wait for the hubs to be colored
+  jp_color_vertex(tD, index);
+}
+
+static void color_parallel_hybrid(ColoringContext ctx,
+                                  unsigned int n_threads) {
+  profile_begin(ctx->par.profile, n_threads);
+  ctx->par.hubs = ctx->vertexes;  // at most every vertex is a hub
+  run_job(ctx, n_threads, hybrid_color_vertex_wrapper);
+}
+
+/* PARALLEL PARTITIONED
+ * Every thread owns a contiguous block of vertices. The interior vertices of
+ * a block (the ones with every neighbour in the same block) are only read and
+ * written by its thread, which colors them with a sequential greedy pass,
+ * without any synchronization. Only the boundary vertices are then colored
+ * with JP, each thread iterating over the boundary of its own block.
+ */
+static void partition_color_vertex(param_t *tD, unsigned int index) {
+  Graph G = tD->G;
+  unsigned int *color = tD->color;
+  unsigned int *weights = tD->weights;
+  unsigned int n_threads = tD->n_threads;
+  int *neighbours_colors =
+      tD->neighbours_colors + (unsigned long)index * tD->neighbours_stride;
+  ThreadProfile *tp = &tD->profile->threads[index];
+  unsigned int from = (unsigned long)G->V * index / n_threads;
+  unsigned int to = (unsigned long)G->V * (index + 1) / n_threads;
+  unsigned int *boundary = tD->vertexes + from;  // in ascending order
+  unsigned int n_boundary = 0;
+
+  /* reset colors, generate weights, and list the boundary of the block */
+  for (unsigned int i = from; i < to; i++) {
+    color[i] = 0;
+    weights[i] = UTIL_hash_random(tD->seed, i);
+    for (link t = G->ladj[i]; t != G->z; t = t->next) {
+      if (t->index < from || t->index >= to) {
+        boundary[n_boundary++] = i;
+        break;
+      }
+    }
+  }
+  pthread_barrier_wait(&tD->barrier);  // wait for every color to be reset
+  end_phase(tD, index, &tD->profile->init_time);
+
+  double start = UTIL_get_time();
+  unsigned int b = 0;
+  for (unsigned int i = from; i < to; i++) {
+    if (b < n_boundary && boundary[b] == i) {
+      b++;  // left to JP
+      continue;
+    }
+    unsigned int j = 0;
+    for (link t = G->ladj[i]; t != G->z; t = t->next) {
+      neighbours_colors[j++] = color[t->index];
+    }
+    color[i] = UTIL_smallest_missing_number(neighbours_colors, G->degree[i]);
+  }
+
+  unsigned int uncolored = n_boundary;
+  unsigned int spins = 0;
+  while (uncolored > 0) {
+    double round_start = UTIL_get_time();
+    unsigned int round_uncolored = uncolored;
+    tp->rounds++;
+    for (b = 0; b < n_boundary; b++) {
+      unsigned int i = boundary[b];
+      if (color[i] == 0) {
+        unsigned int has_highest_number = 1;
+        unsigned int j = 0;
+        for (link t = G->ladj[i]; t != G->z; t = t->next) {
+          unsigned int c = load_color(color, t->index);
+          if (c == 0 &&
+              (weights[t->index] > weights[i] ||
+               (weights[t->index] == weights[i] && t->index > i))) {
+            has_highest_number = 0;
+            break;
+          } else {
+            neighbours_colors[j++] = c;
+          }
+        }
+
+        if (has_highest_number) {
+          store_color(color, i,
+                      UTIL_smallest_missing_number(neighbours_colors,
+                                                   G->degree[i]));
+          uncolored--;
+        }
+      }
+    }
+    if (uncolored == round_uncolored) {
+      tp->spin_time += UTIL_get_time() - round_start;
+      spin_backoff(&spins);
+    } else {
+      spins = 0;
+    }
+  }
+  tp->busy_time = UTIL_get_time() - start;
+}
 
-  free(par);
-  free(weights);
-  free(threads);
-  pthread_mutex_destroy(&mutex);
-  return G->color;
+static void color_parallel_partition(ColoringContext ctx,
+                                     unsigned int n_threads) {
+  profile_begin(ctx->par.profile, n_threads);
+  run_job(ctx, n_threads, partition_color_vertex);
 }
 
-/* PARALLEL LDF PLUS */
-void ldf_plus_color_vertex(Graph G, unsigned int index, unsigned int n_threads,
-                           unsigned int sorted_vertices[]) {
-  unsigned int n = G->V;
-  for (int i = n - 1 - index; i >= 0; i -= n_threads) {
-    unsigned int ii = sorted_vertices[i];
+/* colors G with method, using n_threads of the context's workers */
+static unsigned int *color_with_threads(ColoringContext ctx, Graph G,
+                                        ColoringMethod method,
+                                        unsigned int n_threads,
+                                        unsigned long long seed,
+                                        unsigned int *colors) {
+  if (!reserve_scratch(ctx, G)) {
+    return NULL;
+  }
+  param_t *par = &ctx->par;
+  par->G = G;
+  par->color = colors != NULL ? colors : ctx->colors;
+  par->weights = ctx->weights;
+  par->vertexes = ctx->vertexes;
+  par->degree_count = ctx->degree_count;
+  par->degree_sum = ctx->degree_sum;
+  par->hub_count = ctx->hub_count;
+  par->neighbours_colors = ctx->neighbours_colors;
+  par->neighbours_stride = G->max_degree + 1;
+  par->seed = seed;
+  par->profile = &ctx->profile;
 
-    int *neighbours_colors = malloc(G->degree[ii] * sizeof(int));
-    unsigned int j = 0;
-    for (link t = G->ladj[ii]; t != G->z; t = t->next) {
-      while (G->color[t->index] == 0 &&
-             (G->degree[t->index] > G->degree[ii] ||
-              (G->degree[t->index] == G->degree[ii] && t->index > ii))) {
-        // wait
+  switch (method) {
+    case GRAPH_SEQ_GREEDY:
+      color_sequential_greedy(par);
+      break;
+    case GRAPH_SEQ_LDF:
+      color_sequential_ldf(par);
+      break;
+    case GRAPH_PAR_JP:
+      color_parallel_jp(ctx, n_threads);
+      break;
+    case GRAPH_PAR_LDF:
+      color_parallel_ldf(ctx, n_threads);
+      break;
+    case GRAPH_PAR_LDF_PLUS:
+      color_parallel_ldf_plus(ctx, n_threads);
+      break;
+    case GRAPH_PAR_HYBRID:
+      color_parallel_hybrid(ctx, n_threads);
+      break;
+    case GRAPH_PAR_PARTITION:
+      color_parallel_partition(ctx, n_threads);
+      break;
+    case GRAPH_SEQ_DENSE_GREEDY:
+    case GRAPH_SEQ_DENSE_DSATUR:
+      if (!GRAPH_fits_dense(G)) {
+        fprintf(stderr,
+                "Method %s needs a graph with at most %u vertices, not %u!\n",
+                GRAPH_coloring_methods[method], dense_max_vertices, G->V);
+        return NULL;
       }
-
-      neighbours_colors[j++] = G->color[t->index];
+      if (!reserve_dense(ctx, G)) {
+        return NULL;
+      }
+      if (method == GRAPH_SEQ_DENSE_GREEDY) {
+        color_dense_greedy(par);
+      } else {
+        color_dense_dsatur(par);
+      }
+      break;
+    case GRAPH_AUTO: {
+      /* dispatch to the method expected to be the fastest for this graph */
+      unsigned int auto_threads;
+      const char *name = GRAPH_auto_select(G, n_threads, &auto_threads);
+      return color_with_threads(ctx, G, GRAPH_coloring_method_from_str(name),
+                                auto_threads, seed, colors);
     }
-    G->color[ii] = UTIL_smallest_missing_number(neighbours_colors, G->degree[ii]);
 
-    free(neighbours_colors);
+    default:
+      fprintf(stderr, "Passed coloring method %d is not valid!\n", method);
+      return NULL;
   }
+  return par->color;
 }
 
-void ldf_plus_color_vertex_wrapper(void *par) {
-  param_t *tD = (param_t *)par;
-  unsigned int index = tD->index;
-  pthread_mutex_unlock(tD->lock);
-  ldf_plus_color_vertex(tD->G, index, tD->n_threads, tD->weights);
-}
-
-unsigned int *color_parallel_ldf_plus(Graph G, unsigned int n_threads) {
-  unsigned int n = G->V;
-  unsigned int *degree = malloc(n * sizeof(unsigned int));
-  if (degree == NULL) {
-    printf("Error allocating degrees array!\n");
-    return NULL;
+/* PARALLEL VALIDATION */
+static void compute_class_stats(unsigned int *class_size, unsigned int k,
+                                ColorStats *stats) {
+  stats->colors_used = k;
+  stats->min_class_size = 0;
+  stats->max_class_size = 0;
+  stats->class_size_stddev = 0;
+  if (k == 0) {
+    return;
   }
-  unsigned int *vertex = malloc(n * sizeof(unsigned int));
-  if (vertex == NULL) {
-    printf("Error allocating vertex array!\n");
-    return NULL;
+  double sum = 0, sq_sum = 0;
+  stats->min_class_size = class_size[1];
+  for (unsigned int c = 1; c <= k; c++) {
+    if (class_size[c] < stats->min_class_size) {
+      stats->min_class_size = class_size[c];
+    }
+    if (class_size[c] > stats->max_class_size) {
+      stats->max_class_size = class_size[c];
+    }
+    sum += class_size[c];
   }
-  for (unsigned int i = 0; i < n; i++) {
-    G->color[i] = 0;
-    degree[i] = G->degree[i];
-    vertex[i] = i;
+  double mean = sum / k;
+  for (unsigned int c = 1; c <= k; c++) {
+    sq_sum += (class_size[c] - mean) * (class_size[c] - mean);
   }
-  UTIL_stable_qsort_values_by_keys(degree, vertex, n);
-
-  free(degree);
-  pthread_mutex_t mutex;
-
-  param_t *par = malloc(sizeof(param_t));
-  par->G = G;
-  par->n_threads = n_threads;
-  par->weights = vertex;
-  par->lock = &mutex;
-  pthread_t *threads = malloc(n_threads * sizeof(pthread_t));
-  pthread_mutex_init(&mutex, NULL);
+  stats->class_size_stddev = sqrt(sq_sum / k);
+}
 
-  for (unsigned int i = 0; i < n_threads; i++) {
-    pthread_mutex_lock(&mutex);
-    par->index = i;
-    pthread_create(&threads[i], NULL, (void *)&ldf_plus_color_vertex_wrapper,
-                   (void *)par);
+/* each thread checks a contiguous range of vertices and, in the same pass,
+ * builds its own histogram of the colors used. As soon as stop_after
+ * conflicts have been recorded by any thread, every thread stops early */
+static void validate_range(void *par) {
+  validation_t *tD = (validation_t *)par;
+  Graph G = tD->G;
+  unsigned int *colors = tD->colors;
+  ColoringReport *report = tD->report;
+  unsigned int hist_size = 64;
+  tD->class_size = calloc(hist_size, sizeof(unsigned int));
+  tD->max_color = 0;
+  tD->conflicts = 0;
+  tD->uncolored = 0;
+  tD->failed = 0;
+  if (tD->class_size == NULL) {
+    fprintf(stderr, "Error allocating class_size array!\n");
+    tD->failed = 1;
+    return;
   }
 
-  for (int i = 0; i < n_threads; i++) {
-    pthread_join(threads[i], NULL);
+  for (unsigned int i = tD->from;
+       i < tD->to &&
+       !atomic_load_explicit(&report->aborted, memory_order_relaxed);
+       i++) {
+    unsigned int c = colors[i];
+    if (c >= hist_size) {
+      /* grow the histogram, colors are usually small so this is rare */
+      unsigned int new_size = hist_size;
+      while (c >= new_size) {
+        new_size *= 2;
+      }
+      unsigned int *tmp =
+          realloc(tD->class_size, new_size * sizeof(unsigned int));
+      if (tmp == NULL) {
+        fprintf(stderr, "Error reallocating class_size array!\n");
+        tD->failed = 1;
+        return;
+      }
+      memset(tmp + hist_size, 0, (new_size - hist_size) * sizeof(unsigned int));
+      tD->class_size = tmp;
+      hist_size = new_size;
+    }
+    tD->class_size[c]++;
+    if (c > tD->max_color) {
+      tD->max_color = c;
+    }
+    if (c == 0) {
+      tD->uncolored++;
+    }
+
+    for (link t = G->ladj[i]; t != G->z; t = t->next) {
+      /* every edge is stored twice, only count it from its smaller end */
+      if (t->index > i && c == colors[t->index]) {
+        tD->conflicts++;
+        pthread_mutex_lock(tD->lock);
+        if (report->n_offenders < GRAPH_MAX_REPORTED_CONFLICTS) {
+          report->offenders[report->n_offenders].from = i;
+          report->offenders[report->n_offenders].to = t->index;
+          report->n_offenders++;
+        }
+        if (tD->stop_after && ++report->recorded >= tD->stop_after) {
+          atomic_store_explicit(&report->aborted, 1, memory_order_relaxed);
+        }
+        pthread_mutex_unlock(tD->lock);
+      }
+    }
   }
-  free(par);
-  free(vertex);
-  free(threads);
-  pthread_mutex_destroy(&mutex);
-  return G->color;
 }
 
 /* EXPOSED FUNCTIONS */
@@ -414,6 +1465,153 @@ unsigned int GRAPH_check_current_coloring_validity(Graph G) {
   return 1;
 }
 
+/* BALANCED COLORING
+ * Takes a valid coloring and moves vertices out of the classes that are
+ * bigger than the target size ceil(V/k) into the smallest class that none of
+ * their neighbours uses, so that the k color classes end up having
+ * (almost) the same size. No new color is ever introduced, so the number of
+ * colors used can't increase.
+ */
+unsigned int *GRAPH_balance_coloring(Graph G, unsigned int *colors) {
+  unsigned int n = G->V;
+  unsigned int k = UTIL_max_in_array(colors, n);
+  if (k == 0) {
+    return colors;
+  }
+  unsigned int *class_size = calloc(k + 1, sizeof(unsigned int));
+  if (class_size == NULL) {
+    fprintf(stderr, "Error allocating class_size array!\n");
+    return NULL;
+  }
+  unsigned int *mark = calloc(k + 1, sizeof(unsigned int));
+  if (mark == NULL) {
+    fprintf(stderr, "Error allocating mark array!\n");
+    free(class_size);
+    return NULL;
+  }
+  for (unsigned int i = 0; i < n; i++) {
+    class_size[colors[i]]++;
+  }
+  /* uncolored vertices (color 0) are left as they are, so that balancing
+   * never hides an incomplete coloring */
+  unsigned int colored = n - class_size[0];
+  unsigned int target = colored / k + (colored % k != 0);
+
+  for (unsigned int i = 0; i < n; i++) {
+    if (colors[i] == 0 || class_size[colors[i]] <= target) {
+      continue;
+    }
+    /* mark the colors used in the neighbourhood of i, using i + 1 as a stamp
+     * so that the mark array never needs to be cleared */
+    for (link t = G->ladj[i]; t != G->z; t = t->next) {
+      mark[colors[t->index]] = i + 1;
+    }
+    unsigned int best = 0;
+    for (unsigned int c = 1; c <= k; c++) {
+      if (mark[c] != i + 1 && class_size[c] < target &&
+          (best == 0 || class_size[c] < class_size[best])) {
+        best = c;
+      }
+    }
+    if (best != 0) {
+      class_size[colors[i]]--;
+      class_size[best]++;
+      colors[i] = best;
+    }
+  }
+
+  free(mark);
+  free(class_size);
+  return colors;
+}
+
+unsigned int GRAPH_validate_coloring(Graph G, unsigned int *colors,
+                                     unsigned int n_threads,
+                                     unsigned int stop_after,
+                                     ColoringReport *report) {
+  pthread_mutex_t mutex;
+  memset(report, 0, sizeof(ColoringReport));
+
+  validation_t *par = malloc(n_threads * sizeof(validation_t));
+  pthread_t *threads = malloc(n_threads * sizeof(pthread_t));
+  if (par == NULL || threads == NULL) {
+    fprintf(stderr, "Error allocating validation threads!\n");
+    free(par);
+    free(threads);
+    report->failed = 1;
+    return 0;
+  }
+  pthread_mutex_init(&mutex, NULL);
+
+  for (unsigned int i = 0; i < n_threads; i++) {
+    par[i].G = G;
+    par[i].colors = colors;
+    par[i].from = (unsigned long)G->V * i / n_threads;
+    par[i].to = (unsigned long)G->V * (i + 1) / n_threads;
+    par[i].stop_after = stop_after;
+    par[i].report = report;
+    par[i].lock = &mutex;
+  }
+  unsigned int started = 0;  // the ranges validated, only they are merged
+  if (n_threads == 1) {
+    /* a single range is validated by the calling thread, so that colorings
+     * done with one thread (e.g. the small graphs of batch mode) don't pay
+     * for a thread creation each */
+    validate_range(&par[0]);
+    started = 1;
+  } else {
+    for (; started < n_threads; started++) {
+      if (pthread_create(&threads[started], NULL, (void *)&validate_range,
+                         (void *)&par[started])) {
+        /* the ranges left out make the validation fail, the threads that
+         * did start are still joined */
+        fprintf(stderr, "Error creating the validation threads!\n");
+        report->failed = 1;
+        break;
+      }
+    }
+    for (unsigned int i = 0; i < started; i++) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+
+  /* merge the per-thread results */
+  unsigned int k = 0;
+  for (unsigned int i = 0; i < started; i++) {
+    report->conflicts += par[i].conflicts;
+    report->uncolored += par[i].uncolored;
+    report->failed |= par[i].failed;
+    if (par[i].max_color > k) {
+      k = par[i].max_color;
+    }
+  }
+  if (!report->failed) {
+    report->class_size = calloc(k + 1, sizeof(unsigned int));
+    if (report->class_size == NULL) {
+      fprintf(stderr, "Error allocating class_size array!\n");
+      report->failed = 1;
+    }
+  }
+  for (unsigned int i = 0; i < started; i++) {
+    if (!report->failed) {
+      for (unsigned int c = 0; c <= par[i].max_color; c++) {
+        report->class_size[c] += par[i].class_size[c];
+      }
+    }
+    free(par[i].class_size);
+  }
+  if (!report->failed && !report->aborted) {
+    compute_class_stats(report->class_size, k, &report->stats);
+  }
+  report->valid =
+      !report->failed && report->conflicts == 0 && report->uncolored == 0;
+
+  free(par);
+  free(threads);
+  pthread_mutex_destroy(&mutex);
+  return report->valid;
+}
+
 unsigned int GRAPH_get_edge_count(Graph G) { return G->E; }
 
 unsigned int GRAPH_get_vertex_count(Graph G) { return G->V; }
@@ -421,7 +1619,7 @@ unsigned int GRAPH_get_vertex_count(Graph G) { return G->V; }
 Graph GRAPH_load_from_file(char *filename) {
   FILE *fp = fopen(filename, "r");
   if (fp == NULL) {
-    printf("Error opening file %s\n", filename);
+    fprintf(stderr, "Error opening file %s\n", filename);
     return NULL;
   }
   char *dot = strrchr(filename, '.');
@@ -466,7 +1664,8 @@ Graph GRAPH_load_from_file(char *filename) {
             if (p == e) break;
             if (from != to) {
               if (EDGE_insert(G, from - 1, to - 1) == NULL) {
-                printf("Couldn't insert edge from %d to %d\n", from, to);
+                fprintf(stderr, "Couldn't insert edge from %d to %d\n", from,
+                        to);
                 fclose(fp);
                 GRAPH_free(G);
                 return NULL;
@@ -483,7 +1682,8 @@ Graph GRAPH_load_from_file(char *filename) {
             if (p == e) break;
             if (alternate % 2 == 0 && from != to) {
               if (EDGE_insert(G, from - 1, to - 1) == NULL) {
-                printf("Couldn't insert edge from %d to %d\n", from, to);
+                fprintf(stderr, "Couldn't insert edge from %d to %d\n", from,
+                        to);
                 fclose(fp);
                 GRAPH_free(G);
                 return NULL;
@@ -493,7 +1693,7 @@ Graph GRAPH_load_from_file(char *filename) {
           }
           break;
         default:
-          printf("Invalid fmt\n");
+          fprintf(stderr, "Invalid fmt\n");
           fclose(fp);
           GRAPH_free(G);
           return NULL;
@@ -501,6 +1701,7 @@ Graph GRAPH_load_from_file(char *filename) {
       from++;
     }
     fclose(fp);
+    compute_features(G);
     return G;
   } else if (!strcmp(dot, ".gra")) {
     int V = -1;
@@ -526,13 +1727,13 @@ Graph GRAPH_load_from_file(char *filename) {
       while (strcmp(buf, "#")) {
         int to = atoi(buf);
         if (EDGE_insert(G, i, to) == NULL) {
-          printf("Couldn't insert edge from %d to %d\n", i, to);
+          fprintf(stderr, "Couldn't insert edge from %d to %d\n", i, to);
           fclose(fp);
           GRAPH_free(G);
           return NULL;
         }
         if (EDGE_insert(G, to, i) == NULL) {
-          printf("Couldn't insert edge from %d to %d\n", to, i);
+          fprintf(stderr, "Couldn't insert edge from %d to %d\n", to, i);
           fclose(fp);
           GRAPH_free(G);
           return NULL;
@@ -541,14 +1742,120 @@ Graph GRAPH_load_from_file(char *filename) {
       }
     }
     fclose(fp);
+    compute_features(G);
     return G;
   } else {
-    printf("Invalid extension %s\n", dot);
+    fprintf(stderr, "Invalid extension %s\n", dot);
     fclose(fp);
     return NULL;
   }
 }
 
+/* Builds an undirected graph from a list of edges, each given once in either
+ * direction. Self loops and duplicated edges are ignored. The adjacency lists
+ * are built by n_threads threads, the edges are still owned by the caller.
+ */
+Graph GRAPH_build_from_edges(unsigned int V, Edge *edges,
+                             unsigned long n_edges, unsigned int n_threads) {
+  Graph G = GRAPH_init(V);
+  if (G == NULL) {
+    return NULL;
+  }
+  unsigned long *offsets = calloc((unsigned long)V + 1, sizeof(unsigned long));
+  unsigned long *next = malloc((unsigned long)V * sizeof(unsigned long));
+  if (offsets == NULL || next == NULL) {
+    fprintf(stderr, "Error allocating edge offsets!\n");
+    free(offsets);
+    free(next);
+    GRAPH_free(G);
+    return NULL;
+  }
+
+  /* bucket the neighbours of every vertex (counting sort by vertex) */
+  for (unsigned long e = 0; e < n_edges; e++) {
+    if (edges[e].from != edges[e].to) {
+      offsets[edges[e].from + 1]++;
+      offsets[edges[e].to + 1]++;
+    }
+  }
+  for (unsigned int v = 0; v < V; v++) {
+    offsets[v + 1] += offsets[v];
+    next[v] = offsets[v];
+  }
+  /* one spare slot, so that a graph without edges still gets a buffer */
+  unsigned int *neighbours =
+      malloc((offsets[V] + 1) * sizeof(unsigned int));
+  if (neighbours == NULL) {
+    fprintf(stderr, "Error allocating neighbours array!\n");
+    free(offsets);
+    free(next);
+    GRAPH_free(G);
+    return NULL;
+  }
+  for (unsigned long e = 0; e < n_edges; e++) {
+    if (edges[e].from != edges[e].to) {
+      neighbours[next[edges[e].from]++] = edges[e].to;
+      neighbours[next[edges[e].to]++] = edges[e].from;
+    }
+  }
+  free(next);
+
+  /* on huge pages, every list gets the slice of a single block of nodes that
+   * matches its slice of neighbours, so threads need no locking */
+  NodeBlock *block = NULL;
+  if (G->huge_pages && offsets[V] > 0) {
+    block = node_block_new(G, offsets[V]);
+    if (block == NULL) {
+      fprintf(stderr, "Error allocating the nodes of the lists!\n");
+      free(offsets);
+      free(neighbours);
+      GRAPH_free(G);
+      return NULL;
+    }
+    block->used = offsets[V];
+  }
+  build_t *par = malloc(n_threads * sizeof(build_t));
+  pthread_t *threads = malloc(n_threads * sizeof(pthread_t));
+  if (par == NULL || threads == NULL) {
+    fprintf(stderr, "Error allocating build threads!\n");
+    free(par);
+    free(threads);
+    free(offsets);
+    free(neighbours);
+    GRAPH_free(G);
+    return NULL;
+  }
+  for (unsigned int i = 0; i < n_threads; i++) {
+    par[i].G = G;
+    par[i].offsets = offsets;
+    par[i].neighbours = neighbours;
+    par[i].nodes = block != NULL ? block->nodes : NULL;
+    par[i].from = (unsigned long)V * i / n_threads;
+    par[i].to = (unsigned long)V * (i + 1) / n_threads;
+    pthread_create(&threads[i], NULL, (void *)&build_range, (void *)&par[i]);
+  }
+  unsigned int failed = 0;
+  for (unsigned int i = 0; i < n_threads; i++) {
+    pthread_join(threads[i], NULL);
+    failed |= par[i].failed;
+    G->E += par[i].edges;
+    if (par[i].max_degree > G->max_degree) {
+      G->max_degree = par[i].max_degree;
+    }
+  }
+  free(par);
+  free(threads);
+  free(offsets);
+  free(neighbours);
+  if (failed) {
+    fprintf(stderr, "Couldn't build the adjacency lists\n");
+    GRAPH_free(G);
+    return NULL;
+  }
+  compute_features(G);
+  return G;
+}
+
 Graph GRAPH_init(unsigned int V) {
   Graph G = malloc(sizeof *G);
   if (G == NULL) {
@@ -557,10 +1864,25 @@ Graph GRAPH_init(unsigned int V) {
   }
   G->V = V;
   G->E = 0;
+  G->max_degree = 0;
+  G->has_features = 0;
+  G->huge_pages = use_huge_pages;
+  G->blocks = NULL;
+  G->hugetlb_bytes = G->transparent_bytes = 0;
   G->z = LINK_new(-1, NULL);
-  G->ladj = malloc(V * sizeof(link));
-  G->degree = malloc(V * sizeof(unsigned int));
-  G->color = malloc(V * sizeof(unsigned int));
+  G->ladj = graph_alloc(G, (unsigned long)V * sizeof(link));
+  G->degree = graph_alloc(G, (unsigned long)V * sizeof(unsigned int));
+  G->color = graph_alloc(G, (unsigned long)V * sizeof(unsigned int));
+  if (G->z == NULL || G->ladj == NULL || G->degree == NULL ||
+      G->color == NULL) {
+    fprintf(stderr, "Error while allocating the graph\n");
+    free(G->z);
+    graph_free_array(G, G->ladj, (unsigned long)V * sizeof(link));
+    graph_free_array(G, G->degree, (unsigned long)V * sizeof(unsigned int));
+    graph_free_array(G, G->color, (unsigned long)V * sizeof(unsigned int));
+    free(G);
+    return NULL;
+  }
 
   for (unsigned int i = 0; i < V; i++) {
     G->ladj[i] = G->z;
@@ -575,15 +1897,21 @@ void GRAPH_free(Graph G) {
     return;
   }
   link next;
-  for (int i = 0; i < G->V; i++) {
+  while (G->blocks != NULL) {
+    NodeBlock *b = G->blocks;
+    G->blocks = b->next;
+    UTIL_free_huge(b->nodes, b->size * sizeof(struct node));
+    free(b);
+  }
+  for (int i = 0; !G->huge_pages && i < G->V; i++) {
     for (link t = G->ladj[i]; t != G->z; t = next) {
       next = t->next;
       free(t);
     }
   }
-  free(G->ladj);
-  free(G->degree);
-  free(G->color);
+  graph_free_array(G, G->ladj, (unsigned long)G->V * sizeof(link));
+  graph_free_array(G, G->degree, (unsigned long)G->V * sizeof(unsigned int));
+  graph_free_array(G, G->color, (unsigned long)G->V * sizeof(unsigned int));
   free(G->z);
   free(G);
 }
@@ -608,8 +1936,153 @@ void GRAPH_ladj_print_with_colors(Graph G, unsigned int *colors) {
   }
 }
 
+#define SAVE_BUFFER_SIZE (1 << 20)
+
+/* Writes the colors to file as the narrowest integers that fit them, a chunk
+ * at a time */
+static int save_binary_coloring(Graph G, unsigned int *colors, FILE *file,
+                                char *buffer) {
+  ColoringHeader header;
+  memset(&header, 0, sizeof(ColoringHeader));
+  memcpy(header.magic, GRAPH_COLORING_MAGIC, sizeof(header.magic));
+  header.vertex_count = G->V;
+  for (unsigned int i = 0; i < G->V; i++) {
+    if (colors[i] > header.colors_used) {
+      header.colors_used = colors[i];
+    }
+  }
+  header.color_bytes = header.colors_used <= 0xFF     ? 1
+                       : header.colors_used <= 0xFFFF ? 2
+                                                      : 4;
+  if (fwrite(&header, sizeof(ColoringHeader), 1, file) != 1) {
+    return 0;
+  }
+  if (header.color_bytes == 4) {
+    return fwrite(colors, sizeof(unsigned int), G->V, file) == G->V;
+  }
+
+  unsigned int chunk = SAVE_BUFFER_SIZE / header.color_bytes;
+  for (unsigned int i = 0; i < G->V; i += chunk) {
+    unsigned int n = G->V - i < chunk ? G->V - i : chunk;
+    for (unsigned int j = 0; j < n; j++) {
+      if (header.color_bytes == 1) {
+        ((unsigned char *)buffer)[j] = colors[i + j];
+      } else {
+        ((unsigned short *)buffer)[j] = colors[i + j];
+      }
+    }
+    if (fwrite(buffer, header.color_bytes, n, file) != n) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Writes one color per line, formatting the numbers by hand into a buffer
+ * that is written when full, instead of calling fprintf for each vertex */
+static int save_text_coloring(Graph G, unsigned int *colors, FILE *file,
+                              char *buffer) {
+  unsigned int used = 0;
+  for (unsigned int i = 0; i < G->V; i++) {
+    if (used > SAVE_BUFFER_SIZE - 16) {  // room for the longest line
+      if (fwrite(buffer, 1, used, file) != used) {
+        return 0;
+      }
+      used = 0;
+    }
+    char digits[10];
+    unsigned int n = 0, c = colors[i];
+    do {
+      digits[n++] = '0' + c % 10;
+      c /= 10;
+    } while (c > 0);
+    while (n > 0) {
+      buffer[used++] = digits[--n];
+    }
+    buffer[used++] = '\n';
+  }
+  return fwrite(buffer, 1, used, file) == used;
+}
+
+/* Saves the coloring of G to filename, either in the binary format described
+ * by ColoringHeader or as text with the color of the ith vertex on the ith
+ * line. Returns 1 on success, 0 otherwise.
+ */
+int GRAPH_save_coloring(Graph G, unsigned int *colors, const char *filename,
+                        OutputFormat format) {
+  FILE *file = fopen(filename, "wb");
+  if (file == NULL) {
+    fprintf(stderr, "Error opening %s\n", filename);
+    return 0;
+  }
+  char *buffer = malloc(SAVE_BUFFER_SIZE);
+  if (buffer == NULL) {
+    fprintf(stderr, "Error allocating the output buffer!\n");
+    fclose(file);
+    return 0;
+  }
+  int saved = format == GRAPH_OUTPUT_BINARY
+                  ? save_binary_coloring(G, colors, file, buffer)
+                  : save_text_coloring(G, colors, file, buffer);
+  free(buffer);
+  if (fclose(file) != 0 || !saved) {
+    fprintf(stderr, "Error writing %s\n", filename);
+    return 0;
+  }
+  return 1;
+}
+
+/* Sorts the neighbours of every vertex by descending degree (and index), in
+ * parallel. LDF stops scanning the neighbours of a vertex at the first
+ * uncolored one with a higher priority, which has a higher degree unless the
+ * random weights break a tie, so it's then usually found first; LDF plus
+ * waits for the neighbours with a higher degree before reading the others'
+ * colors. JP, and so the hybrid and partitioned methods, only compare the
+ * random weights, which are drawn again at each coloring, so they don't
+ * benefit. Doesn't change any coloring, only how fast it's found. Returns 1
+ * on success, 0 otherwise.
+ */
+int GRAPH_sort_adjacency(Graph G, unsigned int n_threads) {
+  sort_adjacency_t *par = malloc(n_threads * sizeof(sort_adjacency_t));
+  pthread_t *threads = malloc(n_threads * sizeof(pthread_t));
+  if (par == NULL || threads == NULL) {
+    fprintf(stderr, "Error allocating sort threads!\n");
+    free(par);
+    free(threads);
+    return 0;
+  }
+  for (unsigned int i = 0; i < n_threads; i++) {
+    par[i].G = G;
+    par[i].from = (unsigned long)G->V * i / n_threads;
+    par[i].to = (unsigned long)G->V * (i + 1) / n_threads;
+    pthread_create(&threads[i], NULL, (void *)&sort_adjacency_range,
+                   (void *)&par[i]);
+  }
+  unsigned int failed = 0;
+  for (unsigned int i = 0; i < n_threads; i++) {
+    pthread_join(threads[i], NULL);
+    failed |= par[i].failed;
+  }
+  free(par);
+  free(threads);
+  if (failed) {
+    fprintf(stderr, "Error allocating the neighbours to sort!\n");
+    return 0;
+  }
+  return 1;
+}
+
 unsigned int *GRAPH_get_degrees(Graph G) { return G->degree; }
 
+unsigned int GRAPH_get_max_degree(Graph G) { return G->max_degree; }
+
+GraphFeatures *GRAPH_get_features(Graph G) {
+  if (!G->has_features) {
+    compute_features(G);
+  }
+  return &G->features;
+}
+
 unsigned long GRAPH_compute_bytes(Graph G) {
   unsigned long long bytes = 0;
   bytes += sizeof(G);
@@ -620,28 +2093,227 @@ unsigned long GRAPH_compute_bytes(Graph G) {
   return bytes;
 }
 
-unsigned int *GRAPH_color(Graph G, char *coloring_method_str,
-                          unsigned int n_threads) {
-  switch (method_str_to_enum(coloring_method_str)) {
-    case seq_greedy:
-      return color_sequential_greedy(G);
-      break;
-    case seq_ldf:
-      return color_sequential_ldf(G);
-      break;
-    case par_jp:
-      return color_parallel_jp(G, n_threads);
-      break;
-    case par_ldf:
-      return color_parallel_ldf(G, n_threads);
-      break;
-    case par_ldf_plus:
-      return color_parallel_ldf_plus(G, n_threads);
-      break;
+/* Makes the graphs and the coloring contexts created from now on allocate
+ * their large arrays (adjacency lists, degrees, colors, weights and sort
+ * buffers) on 2 MB pages, see UTIL_alloc_huge(). Graphs and contexts that
+ * already exist keep their memory.
+ */
+void GRAPH_set_huge_pages(int enabled) { use_huge_pages = enabled; }
 
-    default:
-      fprintf(stderr, "Passed coloring method '%s' is not valid!\n",
-              coloring_method_str);
+/* Sets the largest graphs the dense methods color (their bit matrices take
+ * V^2 / 8 bytes), and the density (the average degree over V - 1) from which
+ * the 'auto' method uses them.
+ */
+void GRAPH_set_dense_thresholds(unsigned int max_vertices,
+                                double min_density) {
+  dense_max_vertices = max_vertices;
+  dense_min_density = min_density;
+}
+
+int GRAPH_fits_dense(Graph G) { return G->V <= dense_max_vertices; }
+
+/* Returns the name of the method the 'auto' method uses for G, and writes
+ * its number of threads: seq_dense_dsatur for graphs dense and small enough,
+ * else the method of the closest calibration entry.
+ */
+const char *GRAPH_auto_select(Graph G, unsigned int max_threads,
+                              unsigned int *n_threads) {
+  GraphFeatures *f = GRAPH_get_features(G);
+  int fits = GRAPH_fits_dense(G);
+  if (fits && G->V > 1 && f->avg_degree / (G->V - 1) >= dense_min_density) {
+    *n_threads = 1;
+    return GRAPH_coloring_methods[GRAPH_SEQ_DENSE_DSATUR];
+  }
+  const char *name = CALIB_select(f, max_threads, n_threads);
+  if (!fits && !strncmp(name, "seq_dense", 9)) {
+    return GRAPH_coloring_methods[GRAPH_SEQ_LDF];  // calibrated on a smaller
+  }                                                // graph
+  return name;
+}
+
+/* bytes of G on reserved huge pages (hugetlb) and on memory advised for
+ * transparent huge pages, which the kernel may back with regular pages */
+void GRAPH_get_huge_page_bytes(Graph G, unsigned long *hugetlb,
+                               unsigned long *transparent) {
+  *hugetlb = G->hugetlb_bytes;
+  *transparent = G->transparent_bytes;
+}
+
+ColoringMethod GRAPH_coloring_method_from_str(const char *coloring_method_str) {
+  for (unsigned int i = 0; i < GRAPH_N_COLORING_METHODS; i++) {
+    if (!strcmp(coloring_method_str, GRAPH_coloring_methods[i])) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* Creates a coloring context with n_threads worker threads, which sleep
+ * between colorings. A context can color any number of graphs, one at a
+ * time, while different contexts can color concurrently.
+ */
+ColoringContext GRAPH_context_create(unsigned int n_threads) {
+  ColoringContext ctx = calloc(1, sizeof(struct coloring_context));
+  if (ctx == NULL) {
+    fprintf(stderr, "Error allocating coloring context!\n");
+    return NULL;
+  }
+  pthread_mutex_init(&ctx->lock, NULL);
+  pthread_cond_init(&ctx->job_ready, NULL);
+  pthread_cond_init(&ctx->job_done, NULL);
+  ctx->huge_pages = use_huge_pages;
+  ctx->threads = malloc(n_threads * sizeof(pthread_t));
+  ctx->workers = malloc(n_threads * sizeof(worker_t));
+  ctx->profile.threads = calloc(n_threads, sizeof(ThreadProfile));
+  ctx->degree_sum = malloc(2 * n_threads * sizeof(double));
+  ctx->hub_count = malloc((n_threads + 1) * sizeof(unsigned int));
+  if (ctx->threads == NULL || ctx->workers == NULL ||
+      ctx->profile.threads == NULL || ctx->degree_sum == NULL ||
+      ctx->hub_count == NULL) {
+    fprintf(stderr, "Error allocating coloring context!\n");
+    GRAPH_context_free(ctx);
+    return NULL;
+  }
+  for (unsigned int i = 0; i < n_threads; i++) {
+    ctx->workers[i].ctx = ctx;
+    ctx->workers[i].index = i;
+    ctx->workers[i].counters_opened = 0;
+    ctx->workers[i].counters.fd_instructions = -1;
+    ctx->workers[i].counters.fd_cache_misses = -1;
+    if (pthread_create(&ctx->threads[i], NULL, worker_loop,
+                       (void *)&ctx->workers[i])) {
+      fprintf(stderr, "Error creating the worker threads!\n");
+      GRAPH_context_free(ctx);
       return NULL;
+    }
+    ctx->n_threads++;  // only count the threads that have to be joined
   }
-}
\ No newline at end of file
+  return ctx;
+}
+
+void GRAPH_context_free(ColoringContext ctx) {
+  if (ctx == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&ctx->lock);
+  ctx->shutdown = 1;
+  pthread_cond_broadcast(&ctx->job_ready);
+  pthread_mutex_unlock(&ctx->lock);
+  for (unsigned int i = 0; i < ctx->n_threads; i++) {
+    pthread_join(ctx->threads[i], NULL);
+    PROF_counters_close(&ctx->workers[i].counters);
+  }
+  pthread_mutex_destroy(&ctx->lock);
+  pthread_cond_destroy(&ctx->job_ready);
+  pthread_cond_destroy(&ctx->job_done);
+  free(ctx->threads);
+  free(ctx->workers);
+  free(ctx->profile.threads);
+  free(ctx->degree_sum);
+  free(ctx->hub_count);
+  if (ctx->huge_pages) {
+    UTIL_free_huge(ctx->weights, 3 * ((unsigned long)ctx->scratch_vertices + 1) *
+                                     sizeof(unsigned int));
+    UTIL_free_huge(ctx->degree_count,
+                   ctx->degree_count_size * sizeof(unsigned int));
+    UTIL_free_huge(ctx->neighbours_colors, ctx->neighbours_size * sizeof(int));
+    UTIL_free_huge(ctx->dense_words,
+                   ctx->dense_size * sizeof(unsigned long long));
+  } else {
+    free(ctx->weights);  // vertexes and colors are in the same allocation
+    free(ctx->degree_count);
+    free(ctx->neighbours_colors);
+    free(ctx->dense_words);
+  }
+  free(ctx);
+}
+
+unsigned int GRAPH_context_get_threads(ColoringContext ctx) {
+  return ctx->n_threads;
+}
+
+/* Pins the i-th worker of the context to the i-th online CPU (round robin),
+ * so that benchmarks aren't affected by thread migrations, or lets them run
+ * on any CPU again. The calling thread, which runs the sequential methods, is
+ * only pinned while GRAPH_context_color() runs, so that the threads it
+ * creates in between (validation, generators, loaders) can use any CPU */
+void GRAPH_context_set_pinning(ColoringContext ctx, int enabled) {
+  ctx->pinned = enabled;
+  for (unsigned int i = 0; i < ctx->n_threads; i++) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    if (enabled) {
+      CPU_SET(i % get_nprocs(), &cpus);
+    } else {
+      for (int c = 0; c < get_nprocs(); c++) {
+        CPU_SET(c, &cpus);
+      }
+    }
+    pthread_setaffinity_np(ctx->threads[i], sizeof(cpu_set_t), &cpus);
+  }
+}
+
+/* phases' timings of the last coloring done with the context */
+ColoringProfile *GRAPH_context_get_profile(ColoringContext ctx) {
+  return &ctx->profile;
+}
+
+/* Lets the workers of the context read their own hardware counters during
+ * each job, from the next coloring on: a thread's counters don't follow the
+ * threads it created before, so the caller only counts its own work */
+void GRAPH_context_set_counters(ColoringContext ctx, int enabled) {
+  ctx->counting = enabled;
+}
+
+/* the workers' hardware counts summed over the last coloring, zero if it
+ * didn't use them and -1 if some couldn't be read */
+HwCounters *GRAPH_context_get_counters(ColoringContext ctx) {
+  return &ctx->counters;
+}
+
+/* Colors G with the given method and all the workers of the context. The
+ * coloring is written to colors, which must hold a color for each vertex, or
+ * if colors is NULL to a buffer owned by the context, valid until its next
+ * coloring. Returns the coloring, or NULL if it failed.
+ */
+unsigned int *GRAPH_context_color(ColoringContext ctx, Graph G,
+                                  ColoringMethod method,
+                                  unsigned long long seed,
+                                  unsigned int *colors) {
+  ctx->counters.instructions = ctx->counters.cache_misses = 0;
+  cpu_set_t previous;
+  int pinned = ctx->pinned && !pthread_getaffinity_np(pthread_self(),
+                                                      sizeof(cpu_set_t),
+                                                      &previous);
+  if (pinned) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(0, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+  }
+  colors = color_with_threads(ctx, G, method, ctx->n_threads, seed, colors);
+  if (pinned) {
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &previous);
+  }
+  return colors;
+}
+
+/* Colors G->color with a context created for this coloring only: repeated
+ * colorings should reuse a context instead, to save the threads' creation.
+ */
+unsigned int *GRAPH_color(Graph G, char *coloring_method_str,
+                          unsigned int n_threads, unsigned long long seed) {
+  ColoringMethod method = GRAPH_coloring_method_from_str(coloring_method_str);
+  if (method == -1) {
+    fprintf(stderr, "Passed coloring method '%s' is not valid!\n",
+            coloring_method_str);
+    return NULL;
+  }
+  ColoringContext ctx = GRAPH_context_create(n_threads);
+  if (ctx == NULL) {
+    return NULL;
+  }
+  unsigned int *colors = GRAPH_context_color(ctx, G, method, seed, G->color);
+  GRAPH_context_free(ctx);
+  return colors;
+}
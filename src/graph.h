@@ -6,6 +6,7 @@
 #include <string.h>
 #include <pthread.h>
 
+#include "prof.h"
 #include "util.h"
 
 typedef struct edge {
@@ -15,17 +16,140 @@ typedef struct edge {
 
 typedef struct graph *Graph;
 
+typedef enum {
+  GRAPH_SEQ_GREEDY,
+  GRAPH_SEQ_LDF,
+  GRAPH_PAR_JP,
+  GRAPH_PAR_LDF,
+  GRAPH_PAR_LDF_PLUS,
+  GRAPH_PAR_HYBRID,
+  GRAPH_PAR_PARTITION,
+  GRAPH_SEQ_DENSE_GREEDY,
+  GRAPH_SEQ_DENSE_DSATUR,
+  GRAPH_AUTO,
+  GRAPH_N_COLORING_METHODS
+} ColoringMethod;
+
+/* the name of each coloring method, e.g. "par_jp" */
+extern const char *GRAPH_coloring_methods[GRAPH_N_COLORING_METHODS];
+
+/* the dense methods color graphs with at most GRAPH_DENSE_MAX_VERTICES
+ * vertices, and 'auto' uses them from GRAPH_DENSE_MIN_DENSITY on */
+#define GRAPH_DENSE_MAX_VERTICES 8192
+#define GRAPH_DENSE_MIN_DENSITY 0.1
+
+/* worker threads and scratch buffers reused between colorings */
+typedef struct coloring_context *ColoringContext;
+
+/* formats of the colorings saved by GRAPH_save_coloring */
+typedef enum { GRAPH_OUTPUT_BINARY, GRAPH_OUTPUT_TEXT } OutputFormat;
+
+/* A binary coloring is this header followed by vertex_count colors (0 for an
+ * uncolored vertex) of color_bytes bytes each, in the machine's byte order,
+ * so that it can be mapped in memory and used as an array.
+ */
+#define GRAPH_COLORING_MAGIC "GRCOLORS"
+typedef struct coloring_header {
+  char magic[8];
+  unsigned int vertex_count;
+  unsigned int colors_used;
+  unsigned int color_bytes;  // 1, 2 or 4, the fewest that fit colors_used
+  unsigned int reserved;
+} ColoringHeader;
+
+typedef struct graph_features {
+  unsigned int vertex_count;
+  unsigned int edge_count;
+  unsigned int max_degree;
+  double avg_degree;
+  double degree_stddev;
+  double degree_skew;  // max degree / average degree
+} GraphFeatures;
+
+typedef struct thread_profile {
+  double busy_time;  // time spent in the coloring phase
+  double spin_time;  // part of busy_time spent waiting for other threads
+  unsigned int rounds;
+} ThreadProfile;
+
+typedef struct coloring_profile {
+  double spawn_time;  // waking up the worker threads, overlaps with the start
+                      // of the initialization
+  double init_time;
+  double sort_time;
+  double color_time;
+  unsigned int rounds;  // the most rounds done by a thread
+  unsigned int n_threads;
+  ThreadProfile *threads;
+} ColoringProfile;
+
+typedef struct color_stats {
+  unsigned int colors_used;
+  unsigned int min_class_size;
+  unsigned int max_class_size;
+  double class_size_stddev;
+} ColorStats;
+
+#define GRAPH_MAX_REPORTED_CONFLICTS 8
+
+/* If the validation is aborted, or fails, the histogram and the stats only
+ * cover part of the vertices, and the stats are left zeroed */
+typedef struct coloring_report {
+  unsigned int valid;
+  unsigned long conflicts;  // conflicting edges, a lower bound if aborted
+  unsigned long uncolored;
+  _Atomic unsigned int aborted;  // read by every validating thread
+  unsigned int failed;           // couldn't allocate the histograms
+  unsigned int recorded;
+  unsigned int n_offenders;
+  Edge offenders[GRAPH_MAX_REPORTED_CONFLICTS];
+  unsigned int *class_size;  // histogram of the colors, freed by the caller
+  ColorStats stats;
+} ColoringReport;
+
 unsigned int GRAPH_get_edge_count(Graph G);
 unsigned int GRAPH_get_vertex_count(Graph G);
 Graph GRAPH_load_from_file(char *filename);
 Graph GRAPH_init(unsigned int V);
+Graph GRAPH_build_from_edges(unsigned int V, Edge *edges,
+                             unsigned long n_edges, unsigned int n_threads);
 void GRAPH_free(Graph G);
 void GRAPH_ladj_print(Graph G);
 void GRAPH_ladj_print_with_colors(Graph G, unsigned int *colors);
-unsigned int *GRAPH_color(Graph G, char *coloring_method_str, unsigned int n_threads);
+int GRAPH_sort_adjacency(Graph G, unsigned int n_threads);
+int GRAPH_save_coloring(Graph G, unsigned int *colors, const char *filename,
+                        OutputFormat format);
+ColoringMethod GRAPH_coloring_method_from_str(const char *coloring_method_str);
+ColoringContext GRAPH_context_create(unsigned int n_threads);
+void GRAPH_context_free(ColoringContext ctx);
+unsigned int GRAPH_context_get_threads(ColoringContext ctx);
+void GRAPH_context_set_pinning(ColoringContext ctx, int enabled);
+ColoringProfile *GRAPH_context_get_profile(ColoringContext ctx);
+void GRAPH_context_set_counters(ColoringContext ctx, int enabled);
+HwCounters *GRAPH_context_get_counters(ColoringContext ctx);
+unsigned int *GRAPH_context_color(ColoringContext ctx, Graph G,
+                                  ColoringMethod method,
+                                  unsigned long long seed,
+                                  unsigned int *colors);
+unsigned int *GRAPH_color(Graph G, char *coloring_method_str,
+                          unsigned int n_threads, unsigned long long seed);
 unsigned int *GRAPH_get_degrees(Graph G);
+unsigned int GRAPH_get_max_degree(Graph G);
+GraphFeatures *GRAPH_get_features(Graph G);
 unsigned int GRAPH_check_given_coloring_validity(Graph G, unsigned int *colors);
 unsigned int GRAPH_check_current_coloring_validity(Graph G);
+unsigned int *GRAPH_balance_coloring(Graph G, unsigned int *colors);
+unsigned int GRAPH_validate_coloring(Graph G, unsigned int *colors,
+                                     unsigned int n_threads,
+                                     unsigned int stop_after,
+                                     ColoringReport *report);
 unsigned long GRAPH_compute_bytes(Graph G);
+void GRAPH_set_huge_pages(int enabled);
+void GRAPH_set_dense_thresholds(unsigned int max_vertices, double min_density);
+int GRAPH_fits_dense(Graph G);
+const char *GRAPH_auto_select(Graph G, unsigned int max_threads,
+                              unsigned int *n_threads);
+void GRAPH_get_huge_page_bytes(Graph G, unsigned long *hugetlb,
+                               unsigned long *transparent);
 
 #endif
\ No newline at end of file
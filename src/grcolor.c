@@ -1,32 +1,203 @@
 #include <dirent.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/sysinfo.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "batch.h"
+#include "bench.h"
+#include "calib.h"
+#include "gen.h"
 #include "graph.h"
+#include "prof.h"
+#include "queue.h"
 #include "util.h"
 
-#define N_COLORING_METHODS 5
-
 typedef struct bench_res {
   char *graph_name;
-  char *coloring_method;
+  const char *coloring_method;
   unsigned int vertex_count;
   unsigned int colors_used;
   unsigned int n_threads;
   double coloring_time;
+  double validate_time;
+  ColoringProfile *profile;
+  HwCounters counters;
+  unsigned long long seed;
+  unsigned int balanced;
+  double balance_time;
+  ColoringReport report;
 } Results;
 
+static void write_csv_header(FILE *csv_file) {
+  fprintf(csv_file,
+          "graph_name,vertex_count,coloring_method,n_threads,coloring_time,"
+          "init_time,colors_used,seed,balanced,balance_time,class_size_min,"
+          "class_size_max,class_size_stddev,spawn_time,sort_time,color_time,"
+          "validate_time,rounds,busy_time_avg,busy_time_max,spin_time_avg,"
+          "spin_time_max,instructions,cache_misses\n");
+}
+
+static void write_csv_row(FILE *csv_file, Results *res) {
+  ColoringProfile *p = res->profile;
+  double busy_sum = 0, busy_max = 0, spin_sum = 0, spin_max = 0;
+  for (unsigned int t = 0; t < p->n_threads; t++) {
+    busy_sum += p->threads[t].busy_time;
+    spin_sum += p->threads[t].spin_time;
+    if (p->threads[t].busy_time > busy_max) {
+      busy_max = p->threads[t].busy_time;
+    }
+    if (p->threads[t].spin_time > spin_max) {
+      spin_max = p->threads[t].spin_time;
+    }
+  }
+  fprintf(csv_file,
+          "%s,%d,%s,%d,%09f,%09f,%d,%llu,%d,%09f,%d,%d,%f,%09f,%09f,%09f,%09f,"
+          "%d,%09f,%09f,%09f,%09f,%lld,%lld\n",
+          res->graph_name, res->vertex_count, res->coloring_method,
+          res->n_threads, res->coloring_time, p->init_time, res->colors_used,
+          res->seed, res->balanced, res->balance_time,
+          res->report.stats.min_class_size, res->report.stats.max_class_size,
+          res->report.stats.class_size_stddev, p->spawn_time, p->sort_time,
+          p->color_time, res->validate_time, p->rounds,
+          p->n_threads ? busy_sum / p->n_threads : 0, busy_max,
+          p->n_threads ? spin_sum / p->n_threads : 0, spin_max,
+          res->counters.instructions, res->counters.cache_misses);
+}
+
+/* a graph loaded ahead of time, NULL if its file couldn't be loaded */
+typedef struct loaded_graph {
+  Graph G;
+  double load_time;
+} LoadedGraph;
+
+typedef struct prefetch_struct {
+  char **filenames;
+  int n_graphs;
+  unsigned int n_threads;  // used by the generators
+  unsigned long long seed;
+  Queue queue;
+} prefetch_t;
+
+/* Loads the graph from file, or generates it if it's a generator's spec (the
+ * same graph for every run, unless --seed is given) */
+static LoadedGraph *load_graph(char *filename, unsigned int n_threads,
+                               unsigned long long seed) {
+  LoadedGraph *loaded = malloc(sizeof(LoadedGraph));
+  if (loaded == NULL) {
+    printf("Error allocating loaded graph!\n");
+    return NULL;
+  }
+  double start = UTIL_get_time();
+  loaded->G = GEN_is_spec(filename) ? GEN_generate(filename, n_threads, seed)
+                                    : GRAPH_load_from_file(filename);
+  loaded->load_time = UTIL_get_time() - start;
+  return loaded;
+}
+
+/* Loads the graphs in order, while the main thread colors the previous ones.
+ * The queue's capacity bounds how many loaded graphs wait to be colored, so
+ * at most capacity + 1 graphs are in memory besides the one being colored.
+ */
+static void *prefetch_graphs(void *par) {
+  prefetch_t *p = (prefetch_t *)par;
+  for (int i = 0; i < p->n_graphs; i++) {
+    LoadedGraph *loaded = load_graph(p->filenames[i], p->n_threads, p->seed);
+    if (loaded == NULL || !QUEUE_push(p->queue, loaded)) {
+      break;
+    }
+  }
+  QUEUE_close(p->queue);
+  return NULL;
+}
+
+static int compare_uints(const void *a, const void *b) {
+  unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+  return (x > y) - (x < y);
+}
+
+/* Parses a comma separated list of thread counts (e.g. "1,2,4,8") into a new
+ * ascending array without duplicates. Returns the number of thread counts, or
+ * 0 if any of them is invalid.
+ */
+static unsigned int parse_thread_counts(char *list, unsigned int **counts) {
+  unsigned int n = 0;
+  *counts = NULL;
+  for (char *t = strtok(list, ","); t != NULL; t = strtok(NULL, ",")) {
+    int value = atoi(t);
+    if (value <= 0) {
+      free(*counts);
+      *counts = NULL;
+      return 0;
+    }
+    *counts = realloc(*counts, (n + 1) * sizeof(unsigned int));
+    (*counts)[n++] = value;
+  }
+  return n;
+}
+
+/* Sorts the thread counts and removes the duplicates, returning how many are
+ * left */
+static unsigned int sort_thread_counts(unsigned int *counts, unsigned int n) {
+  unsigned int unique = 0;
+  qsort(counts, n, sizeof(unsigned int), compare_uints);
+  for (unsigned int i = 0; i < n; i++) {
+    if (unique == 0 || counts[i] != counts[unique - 1]) {
+      counts[unique++] = counts[i];
+    }
+  }
+  return unique;
+}
+
+/* appends to the calibration table the fastest method for a graph */
+static void add_calibration_entry(CalibEntry **calibration, int *n,
+                                  GraphFeatures *features, const char *method,
+                                  unsigned int n_threads) {
+  CalibEntry *tmp = realloc(*calibration, (*n + 1) * sizeof(CalibEntry));
+  if (tmp == NULL) {
+    printf("Error allocating calibration table!\n");
+    return;
+  }
+  *calibration = tmp;
+  CalibEntry *entry = &tmp[(*n)++];
+  entry->vertex_count = features->vertex_count;
+  entry->avg_degree = features->avg_degree;
+  entry->degree_skew = features->degree_skew;
+  snprintf(entry->method, CALIB_METHOD_LEN, "%s", method);
+  entry->n_threads = n_threads;
+}
+
 int main(int argc, char *argv[]) {
-  srand(time(NULL));
   char **graphs_filenames = NULL;
   int number_of_graphs = 0;
   int export = 0;
   int par_only = 0;
+  int balance = 0;
+  int perf = 0;
+  int bench = 0;
+  int pin = 0;
+  int warmup = 1;
+  int prefetch = -1;  // -1 until '--prefetch' is given, see the defaults below
+  int fixed_seed = 0;
+  int all_valid = 1;  // the exit status tells scripts if any coloring failed
+  unsigned long long seed = 0;
+  char *calibration_filename = NULL;
+  char *methods_list = NULL;
+  char *batch_manifest = NULL;
+  char *output_dir = NULL;
+  int output_text = 0;
+  int sort_adjacency = 0;
+  int huge_pages = 0;
+  int dense_vertices = GRAPH_DENSE_MAX_VERTICES;
+  double dense_density = GRAPH_DENSE_MIN_DENSITY;
+  int n_loaders = 1;
+  int large_vertices = BATCH_DEFAULT_LARGE_VERTICES;
   int n_threads = get_nprocs();
-  int iterations = 1;
+  unsigned int *thread_counts = NULL;
+  unsigned int n_thread_counts = 0;
+  int iterations = 0;  // 0 until '-n' is given, see the defaults below
 
   if (argc > 1) {
     graphs_filenames = malloc(
@@ -34,11 +205,12 @@ int main(int argc, char *argv[]) {
                                        // graph_filenames passed as arguments
     for (int i = 1; i < argc; i++) {
       /* flag '-t' or '--threads' to specify how many threads to use in parallel
-       * algorithms */
+       * algorithms, or a comma separated list of them to sweep */
       if (!strcmp(argv[i], "--threads") || !strcmp(argv[i], "-t")) {
         if (i + 1 != argc) {
-          n_threads = atoi(argv[i + 1]);
-          if (n_threads <= 0) {
+          free(thread_counts);
+          n_thread_counts = parse_thread_counts(argv[i + 1], &thread_counts);
+          if (n_thread_counts == 0) {
             printf(
                 "Error: '-t|--threads' flag is specified but the number of "
                 "threads is invalid! (negative, zero or not numeric)\n");
@@ -76,6 +248,230 @@ int main(int argc, char *argv[]) {
         continue;
       }
 
+      /* flag '--seed' to make every randomized coloring method reproducible,
+       * by using the same seed for every coloring */
+      if (!strcmp(argv[i], "--seed")) {
+        if (i + 1 != argc) {
+          char *end;
+          seed = strtoull(argv[i + 1], &end, 10);
+          if (end == argv[i + 1] || *end != '\0') {
+            printf(
+                "Error: '--seed' flag is specified but the seed is invalid! "
+                "(not numeric)\n");
+            return 1;
+          }
+          fixed_seed = 1;
+        } else {
+          printf("Error: '--seed' flag is specified without the seed!\n");
+          return 1;
+        }
+
+        i++;  // Move to the next flag
+        continue;
+      }
+
+      /* flag '-m' or '--methods' to specify a comma separated list of coloring
+       * methods to use instead of all of them */
+      if (!strcmp(argv[i], "--methods") || !strcmp(argv[i], "-m")) {
+        if (i + 1 != argc) {
+          methods_list = argv[i + 1];
+        } else {
+          printf(
+              "Error: '-m|--methods' flag is specified without the coloring "
+              "methods!\n");
+          return 1;
+        }
+
+        i++;  // Move to the next flag
+        continue;
+      }
+
+      /* flag '--warmup' to specify how many colorings to discard before
+       * measuring, in benchmark mode */
+      if (!strcmp(argv[i], "--warmup")) {
+        if (i + 1 != argc) {
+          char *end;
+          warmup = strtol(argv[i + 1], &end, 10);
+          if (end == argv[i + 1] || *end != '\0' || warmup < 0) {
+            printf(
+                "Error: '--warmup' flag is specified but the number of "
+                "warm-up iterations is invalid! (negative or not numeric)\n");
+            return 1;
+          }
+        } else {
+          printf(
+              "Error: '--warmup' flag is specified without the number of "
+              "warm-up iterations!\n");
+          return 1;
+        }
+
+        i++;  // Move to the next flag
+        continue;
+      }
+
+      /* flag '--prefetch' to specify how many graphs can be loaded ahead of
+       * the one being colored, 0 to load each graph after coloring the
+       * previous one */
+      if (!strcmp(argv[i], "--prefetch")) {
+        if (i + 1 != argc) {
+          char *end;
+          prefetch = strtol(argv[i + 1], &end, 10);
+          if (end == argv[i + 1] || *end != '\0' || prefetch < 0) {
+            printf(
+                "Error: '--prefetch' flag is specified but the number of "
+                "graphs is invalid! (negative or not numeric)\n");
+            return 1;
+          }
+        } else {
+          printf(
+              "Error: '--prefetch' flag is specified without the number of "
+              "graphs!\n");
+          return 1;
+        }
+
+        i++;  // Move to the next flag
+        continue;
+      }
+
+      /* flag '--calibrate' to regenerate the calibration table used by the
+       * 'auto' coloring method, from the results of this run */
+      if (!strcmp(argv[i], "--calibrate")) {
+        if (i + 1 != argc) {
+          calibration_filename = argv[i + 1];
+        } else {
+          printf(
+              "Error: '--calibrate' flag is specified without the calibration "
+              "file!\n");
+          return 1;
+        }
+
+        i++;  // Move to the next flag
+        continue;
+      }
+
+      /* flag '--output' to save the last coloring of each graph, method and
+       * thread count to a file in the given folder */
+      if (!strcmp(argv[i], "--output")) {
+        if (i + 1 != argc) {
+          output_dir = argv[i + 1];
+        } else {
+          printf("Error: '--output' flag is specified without the folder!\n");
+          return 1;
+        }
+
+        i++;  // Move to the next flag
+        continue;
+      }
+
+      /* flag '--output-text' to save the colorings as text instead of binary
+       */
+      if (!strcmp(argv[i], "--output-text")) {
+        output_text = 1;
+        continue;
+      }
+
+      /* flag '--batch' to color every graph listed in a manifest file (or in
+       * the standard input, if it's '-'), many of them at the same time */
+      if (!strcmp(argv[i], "--batch")) {
+        if (i + 1 != argc) {
+          batch_manifest = argv[i + 1];
+        } else {
+          printf(
+              "Error: '--batch' flag is specified without the manifest "
+              "file!\n");
+          return 1;
+        }
+
+        i++;  // Move to the next flag
+        continue;
+      }
+
+      /* flag '--loaders' to specify how many threads load the graphs of the
+       * batch */
+      if (!strcmp(argv[i], "--loaders")) {
+        if (i + 1 != argc) {
+          n_loaders = atoi(argv[i + 1]);
+          if (n_loaders <= 0) {
+            printf(
+                "Error: '--loaders' flag is specified but the number of "
+                "loaders is invalid! (negative, zero or not numeric)\n");
+            return 1;
+          }
+        } else {
+          printf(
+              "Error: '--loaders' flag is specified without the number of "
+              "loaders!\n");
+          return 1;
+        }
+
+        i++;  // Move to the next flag
+        continue;
+      }
+
+      /* flag '--large-vertices' to specify from how many vertices a graph of
+       * the batch is colored with all the threads, instead of just one */
+      if (!strcmp(argv[i], "--large-vertices")) {
+        if (i + 1 != argc) {
+          large_vertices = atoi(argv[i + 1]);
+          if (large_vertices <= 0) {
+            printf(
+                "Error: '--large-vertices' flag is specified but the number "
+                "of vertices is invalid! (negative, zero or not numeric)\n");
+            return 1;
+          }
+        } else {
+          printf(
+              "Error: '--large-vertices' flag is specified without the number "
+              "of vertices!\n");
+          return 1;
+        }
+
+        i++;  // Move to the next flag
+        continue;
+      }
+
+      /* flag '--dense-vertices' to specify the largest graphs colored by the
+       * dense methods */
+      if (!strcmp(argv[i], "--dense-vertices")) {
+        if (i + 1 != argc) {
+          dense_vertices = atoi(argv[i + 1]);
+          if (dense_vertices < 0 ||
+              (dense_vertices == 0 && strcmp(argv[i + 1], "0"))) {
+            printf(
+                "Error: '--dense-vertices' flag is specified but the number "
+                "of vertices is invalid! (negative or not numeric)\n");
+            return 1;
+          }
+        } else {
+          printf(
+              "Error: '--dense-vertices' flag is specified without the number "
+              "of vertices!\n");
+          return 1;
+        }
+
+        i++;  // Move to the next flag
+        continue;
+      }
+
+      /* flag '--dense-density' to specify from which density the 'auto'
+       * method uses the dense methods */
+      if (!strcmp(argv[i], "--dense-density")) {
+        char *end = NULL;
+        if (i + 1 != argc) {
+          dense_density = strtod(argv[i + 1], &end);
+        }
+        if (end == NULL || end == argv[i + 1] || *end != '\0' ||
+            dense_density < 0 || dense_density > 1) {
+          printf(
+              "Error: '--dense-density' flag is specified but the density is "
+              "invalid! (missing, not numeric, or not between 0 and 1)\n");
+          return 1;
+        }
+
+        i++;  // Move to the next flag
+        continue;
+      }
+
       /* flag '--csv' to specify whether or not we want to export results to
        * csv */
       if (!strcmp(argv[i], "--csv")) {
@@ -90,14 +486,59 @@ int main(int argc, char *argv[]) {
         continue;
       }
 
+      /* flag '--balance' to specify whether or not we want to balance the
+       * size of the color classes after each coloring */
+      if (!strcmp(argv[i], "--balance")) {
+        balance = 1;
+        continue;
+      }
+
+      /* flag '--bench' to run each coloring method several times and report
+       * statistics (median, percentiles, confidence interval, speedup) instead
+       * of the single colorings */
+      if (!strcmp(argv[i], "--bench")) {
+        bench = 1;
+        continue;
+      }
+
+      /* flag '--sort-adj' to sort the neighbours of every vertex by degree
+       * after loading the graph */
+      if (!strcmp(argv[i], "--sort-adj")) {
+        sort_adjacency = 1;
+        continue;
+      }
+
+      /* flag '--hugepages' to allocate the large arrays of the graphs and of
+       * the colorings on 2 MB pages */
+      if (!strcmp(argv[i], "--hugepages")) {
+        huge_pages = 1;
+        continue;
+      }
+
+      /* flag '--pin' to pin each thread to a different CPU */
+      if (!strcmp(argv[i], "--pin")) {
+        pin = 1;
+        continue;
+      }
+
+      /* flag '--perf' to read the hardware counters (instructions and cache
+       * misses) during each coloring */
+      if (!strcmp(argv[i], "--perf")) {
+        perf = 1;
+        continue;
+      }
+
       /* if an argument is not a known flag, it's treated as a graph's filename
        */
       graphs_filenames[number_of_graphs++] = argv[i];
     }
   }
 
-  /* if no graphs' filenames were passed as argument */
-  if (number_of_graphs == 0) {
+  /* if no graphs' filenames were passed as argument (a batch lists its own) */
+  GRAPH_set_huge_pages(huge_pages);
+  GRAPH_set_dense_thresholds(dense_vertices, dense_density);
+
+  if (number_of_graphs == 0 && batch_manifest == NULL) {
     if (graphs_filenames != NULL) {
       free(graphs_filenames);
       graphs_filenames = NULL;
@@ -130,55 +571,224 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  if (n_threads > get_nprocs()) {
-    /* if the number of threads exceeds the number of available logic
-     * processors, the coloring is slower and more error prone */
-    printf(
-        "Lowering the number of threads to %d (number of available logic "
-        "processors in the system)\n",
-        get_nprocs());
-    n_threads = get_nprocs();
+  if (n_thread_counts == 0) {
+    thread_counts = malloc(sizeof(unsigned int));
+    thread_counts[n_thread_counts++] = n_threads;
+  }
+  /* in batch mode the standard output carries the csv rows, so any other
+   * message goes to the standard error */
+  FILE *messages = batch_manifest != NULL ? stderr : stdout;
+  for (unsigned int t = 0; t < n_thread_counts; t++) {
+    if (thread_counts[t] > get_nprocs()) {
+      /* if the number of threads exceeds the number of available logic
+       * processors, the coloring is slower and more error prone */
+      fprintf(messages,
+          "Lowering the number of threads from %d to %d (number of available "
+          "logic processors in the system)\n",
+          thread_counts[t], get_nprocs());
+      thread_counts[t] = get_nprocs();
+    }
+  }
+  n_thread_counts = sort_thread_counts(thread_counts, n_thread_counts);
+  n_threads = thread_counts[n_thread_counts - 1];
+
+  if (iterations == 0) {
+    /* a single coloring is enough to see the results, but a benchmark needs
+     * more samples for its statistics to be meaningful */
+    iterations = bench ? 10 : 1;
+  }
+  if (prefetch == -1) {
+    /* loading the next graph while coloring speeds up the run, but it takes
+     * a CPU away from the colorings, so benchmarks don't do it by default */
+    prefetch = bench ? 0 : 1;
+  }
+
+  if (output_dir != NULL) {
+    mkdir(output_dir, 0755);  // fails harmlessly if it already exists
+  }
+
+  ColoringMethod *coloring_methods = NULL;
+  int n_coloring_methods = 0;
+  if (methods_list != NULL) {
+    /* split the comma separated list of methods */
+    for (char *m = strtok(methods_list, ","); m != NULL; m = strtok(NULL, ",")) {
+      ColoringMethod method = GRAPH_coloring_method_from_str(m);
+      if (method == -1) {
+        printf("Error: '%s' is not a valid coloring method!\n", m);
+        return 1;
+      }
+      coloring_methods = realloc(
+          coloring_methods, (n_coloring_methods + 1) * sizeof(ColoringMethod));
+      coloring_methods[n_coloring_methods++] = method;
+    }
+    if (n_coloring_methods == 0) {
+      printf("Error: '-m|--methods' flag is specified without methods!\n");
+      return 1;
+    }
+  } else if (batch_manifest != NULL) {
+    /* a batch colors each graph once, with the method that suits it */
+    coloring_methods = malloc(sizeof(ColoringMethod));
+    coloring_methods[n_coloring_methods++] = GRAPH_AUTO;
+  } else {
+    /* every method, except 'auto' which picks one of them */
+    coloring_methods =
+        malloc(GRAPH_N_COLORING_METHODS * sizeof(ColoringMethod));
+    for (int m = 0; m < GRAPH_N_COLORING_METHODS; m++) {
+      if (m != GRAPH_AUTO) {
+        coloring_methods[n_coloring_methods++] = m;
+      }
+    }
+  }
+
+  /* load the calibration table used by the 'auto' coloring method */
+  int calibration_entries = CALIB_load(CALIB_DEFAULT_FILENAME);
+  if (calibration_entries > 0) {
+    fprintf(messages, "Loaded %d calibration entries from %s\n",
+            calibration_entries, CALIB_DEFAULT_FILENAME);
   }
 
-  char *coloring_methods[N_COLORING_METHODS] = {
-      "seq_greedy", "seq_ldf", "par_jp", "par_ldf", "par_ldf_plus"};
+  if (batch_manifest != NULL) {
+    /* the colorings are streamed as csv rows to the standard output, while
+     * the summary goes to the standard error */
+    BatchConfig batch_config;
+    batch_config.manifest =
+        strcmp(batch_manifest, "-") ? fopen(batch_manifest, "r") : stdin;
+    if (batch_config.manifest == NULL) {
+      fprintf(stderr, "Error opening %s\n", batch_manifest);
+      return 3;
+    }
+    batch_config.out = stdout;
+    batch_config.methods = coloring_methods;
+    batch_config.n_methods = n_coloring_methods;
+    batch_config.n_workers = n_threads;
+    batch_config.n_loaders = n_loaders;
+    batch_config.large_vertices = large_vertices;
+    batch_config.fixed_seed = fixed_seed;
+    batch_config.seed = seed;
+    all_valid = BATCH_run(&batch_config);
+    if (batch_config.manifest != stdin) {
+      fclose(batch_config.manifest);
+    }
+    free(graphs_filenames);
+    free(coloring_methods);
+    free(thread_counts);
+    return all_valid ? 0 : 5;
+  }
+
+  /* a coloring context (i.e. a pool of worker threads) for each thread count,
+   * reused for every coloring */
+  ColoringContext *contexts =
+      malloc(n_thread_counts * sizeof(ColoringContext));
+  for (unsigned int t = 0; t < n_thread_counts; t++) {
+    contexts[t] = GRAPH_context_create(thread_counts[t]);
+    if (contexts[t] == NULL) {
+      return 4;
+    }
+    if (pin) {
+      GRAPH_context_set_pinning(contexts[t], 1);
+    }
+  }
+
+  CalibEntry *calibration = NULL;  // the best method for each graph
+  int n_calibrated = 0;
+  /* total time and valid runs of each method with each thread count */
+  double *method_time =
+      malloc(n_coloring_methods * n_thread_counts * sizeof(double));
+  int *method_runs = malloc(n_coloring_methods * n_thread_counts * sizeof(int));
 
   Results res;  // struct to hold the results of a coloring (in terms of time
                 // and colors used, not the coloring itself)
   FILE *csv_file = NULL;
   char csv_filename[128];
   if (export) {
-    /* create the csv file where to export results */
+    /* create the csv file where to export results, benchmarks go in their
+     * own subfolder since their columns are different */
     time_t t = time(NULL);
     struct tm now = *localtime(&t);
-    sprintf(csv_filename, "results/results_%d-%02d-%02d_%02d-%02d-%02d.csv",
-            now.tm_year + 1900, now.tm_mon + 1, now.tm_mday, now.tm_hour,
-            now.tm_min, now.tm_sec);
+    if (bench) {
+      mkdir("results/bench", 0755);
+    }
+    sprintf(csv_filename, "results/%s_%d-%02d-%02d_%02d-%02d-%02d.csv",
+            bench ? "bench/bench" : "results", now.tm_year + 1900,
+            now.tm_mon + 1, now.tm_mday, now.tm_hour, now.tm_min, now.tm_sec);
     csv_file = fopen(csv_filename, "w");
     if (csv_file == NULL) {
       printf("Error opening %s\n", csv_filename);
       return 3;
     }
-    fprintf(csv_file,
-            "graph_name,vertex_count,coloring_method,n_threads,coloring_time,"
-            "colors_used\n");  // add the header line
+    if (bench) {
+      BENCH_write_csv_header(csv_file);
+    } else {
+      write_csv_header(csv_file);  // add the header line
+    }
     fclose(csv_file);
   }
 
+  BenchConfig bench_config;
+  bench_config.methods = coloring_methods;
+  bench_config.n_methods = n_coloring_methods;
+  bench_config.contexts = contexts;
+  bench_config.thread_counts = thread_counts;
+  bench_config.n_thread_counts = n_thread_counts;
+  bench_config.warmup = warmup;
+  bench_config.runs = iterations;
+  bench_config.par_only = par_only;
+  bench_config.fixed_seed = fixed_seed;
+
   res.n_threads = n_threads;
+  res.balanced = balance;
+  res.balance_time = 0;
+  memset(&res.counters, 0, sizeof(HwCounters));
+  res.counters.instructions = res.counters.cache_misses = -1;
+  if (perf && !PROF_counters_open(&res.counters)) {
+    printf("Hardware counters are not available, ignoring '--perf'\n");
+  }
+  for (unsigned int t = 0; t < n_thread_counts; t++) {
+    GRAPH_context_set_counters(contexts[t], res.counters.enabled);
+  }
+
+  /* without '--seed', every coloring gets a fresh seed, which is still
+   * exported so that any single coloring can be reproduced later */
+  unsigned long long seed_state = UTIL_splitmix64(time(NULL) ^ getpid());
+  if (fixed_seed) {
+    printf("Using seed %llu for every coloring\n", seed);
+  }
 
   if (number_of_graphs == 0) {
     printf("No graphs found in the /graphs subfolder!\n");
   }
 
+  /* with '--prefetch', a loader thread loads the next graphs while the
+   * current one is being colored */
+  prefetch_t prefetcher;
+  pthread_t loader;
+  prefetcher.filenames = graphs_filenames;
+  prefetcher.n_graphs = number_of_graphs;
+  prefetcher.n_threads = n_threads;
+  prefetcher.seed = fixed_seed ? seed : GEN_DEFAULT_SEED;
+  prefetcher.queue = NULL;
+  if (prefetch > 0 && number_of_graphs > 0) {
+    prefetcher.queue = QUEUE_init(prefetch);
+    if (prefetcher.queue == NULL) {
+      return 4;
+    }
+    pthread_create(&loader, NULL, prefetch_graphs, (void *)&prefetcher);
+  }
+
   for (int i = 0; i < number_of_graphs; i++) {
     /* for each graph */
     double start, finish;
 
-    /* load the graph from file */
-    start = UTIL_get_time();
-    Graph G = GRAPH_load_from_file(graphs_filenames[i]);
-    finish = UTIL_get_time();
+    LoadedGraph *loaded =
+        prefetcher.queue != NULL
+            ? QUEUE_pop(prefetcher.queue)
+            : load_graph(graphs_filenames[i], n_threads, prefetcher.seed);
+    if (loaded == NULL) {
+      break;  // the loader ran out of memory
+    }
+    Graph G = loaded->G;
+    double load_time = loaded->load_time;
+    free(loaded);
 
     /* take the portion of the filename after the last '/' slash */
     char *s = graphs_filenames[i];
@@ -192,12 +802,61 @@ int main(int argc, char *argv[]) {
 
     if (G != NULL) {
       res.vertex_count = GRAPH_get_vertex_count(G);
+      GraphFeatures *features = GRAPH_get_features(G);
       printf(
-          "         GRAPH NAME | LOADED IN | MAX DEGREE | ESTIMATED MEMORY "
-          "FOOTPRINT\n");
-      printf("%19s | %09f |     %02d     | %f MB\n", last, finish - start,
-             UTIL_max_in_array(GRAPH_get_degrees(G), res.vertex_count),
+          "         GRAPH NAME | LOADED IN | MAX DEGREE | AVG DEGREE | "
+          "DEGREE SKEW | ESTIMATED MEMORY FOOTPRINT\n");
+      printf("%19s | %09f |     %02d     | %10.2f | %11.2f | %f MB", last,
+             load_time, features->max_degree, features->avg_degree,
+             features->degree_skew,
              ((double)GRAPH_compute_bytes(G)) / 1024 / 1024);
+      if (huge_pages) {
+        unsigned long hugetlb, transparent;
+        GRAPH_get_huge_page_bytes(G, &hugetlb, &transparent);
+        printf(" (huge pages: %.2f MB reserved, %.2f MB transparent)",
+               (double)hugetlb / 1024 / 1024,
+               (double)transparent / 1024 / 1024);
+      }
+      putchar('\n');
+      if (sort_adjacency) {
+        start = UTIL_get_time();
+        GRAPH_sort_adjacency(G, n_threads);
+        printf("Sorted the adjacency lists in %09f\n",
+               UTIL_get_time() - start);
+      }
+
+      if (bench) {
+        /* the warm-up colorings take the place of the pause between graphs */
+        if (fixed_seed) {
+          bench_config.seed = seed;
+        } else {
+          seed_state = UTIL_splitmix64(seed_state);
+          bench_config.seed = seed_state;
+        }
+        csv_file = export ? fopen(csv_filename, "a") : NULL;
+        if (export && csv_file == NULL) {
+          printf("Error opening %s in append mode\n", csv_filename);
+        }
+        CalibEntry best;
+        all_valid &= BENCH_run_graph(G, last, &bench_config, csv_file,
+                                     calibration_filename != NULL ? &best
+                                                                  : NULL);
+        if (calibration_filename != NULL && best.method[0] != '\0') {
+          add_calibration_entry(&calibration, &n_calibrated, features,
+                                best.method, best.n_threads);
+        }
+        if (csv_file != NULL) {
+          fclose(csv_file);
+        }
+        putchar('\n');
+        GRAPH_free(G);
+        continue;
+      }
+
+      for (int m = 0; m < n_coloring_methods * n_thread_counts; m++) {
+        method_time[m] = 0;
+        method_runs[m] = 0;
+      }
 
       for (int k = 0; k < iterations; k++) {
         /* for each iteration */
@@ -205,59 +864,192 @@ int main(int argc, char *argv[]) {
           printf("Iteration %d of %d\n", k + 1, iterations);
         }
 
-        printf("COLOR METHOD | COLORED IN | COLORS USED | VALID?\n");
-
-        for (int method_number = 0; method_number < N_COLORING_METHODS;
-             method_number++) {
-          /* for each coloring method */
-          
-          /* skip sequential methods if --par flag had been set */
-          if (par_only &&
-              (!strcmp(coloring_methods[method_number], "seq_greedy") ||
-               !strcmp(coloring_methods[method_number], "seq_ldf"))) {
-            continue;
+        for (unsigned int t = 0; t < n_thread_counts; t++) {
+          /* for each thread count */
+          n_threads = thread_counts[t];
+          ColoringContext ctx = contexts[t];
+          res.n_threads = n_threads;
+          if (n_thread_counts > 1) {
+            printf("Using %d threads\n", n_threads);
           }
 
-          res.coloring_method = coloring_methods[method_number];
-          /* color the graph */
-          start = UTIL_get_time();
-          unsigned int *colors =
-              GRAPH_color(G, res.coloring_method, (unsigned int)n_threads);
-          finish = UTIL_get_time();
-
-          /* if the coloring succeeds (i.e: GRAPH_color() returns something !=
-           * NULL)*/
-          if (colors != NULL) {
-            res.colors_used = UTIL_max_in_array(
-                colors,
-                GRAPH_get_vertex_count(
-                    G));  // the number of colors used is the maximum color used
-            res.coloring_time = finish - start;
-            printf("%12s | %09f  |     %02d      | ", res.coloring_method,
-                   res.coloring_time, res.colors_used);
-
-            /* check whether or not the produced coloring is valid */
-            if (GRAPH_check_given_coloring_validity(G, colors)) {
-              printf("YES \n");
-
-              if (export) {
-                // export to csv if flag had been set
-                csv_file = fopen(csv_filename, "a");
-                if (csv_file == NULL) {
-                  printf("Error opening %s in append mode\n", csv_filename);
-                } else {
-                  fprintf(csv_file, "%s,%d,%s,%d,%09f,%d\n", res.graph_name,
-                          res.vertex_count, res.coloring_method, res.n_threads,
-                          res.coloring_time, res.colors_used);
-                  fclose(csv_file);
+          printf("COLOR METHOD | COLORED IN | INITIALIZED IN | COLORS USED | ");
+          if (balance) {
+            printf("BALANCED IN | ");
+          }
+          printf("CLASS MIN | CLASS MAX | CLASS STDDEV | VALID?\n");
+
+          for (int method_number = 0; method_number < n_coloring_methods;
+               method_number++) {
+            /* for each coloring method */
+            ColoringMethod method = coloring_methods[method_number];
+            int is_dense = method == GRAPH_SEQ_DENSE_GREEDY ||
+                           method == GRAPH_SEQ_DENSE_DSATUR;
+            int is_sequential = method == GRAPH_SEQ_GREEDY ||
+                                method == GRAPH_SEQ_LDF || is_dense;
+            int cell = method_number * n_thread_counts + t;
+
+            /* skip sequential methods if --par flag had been set, and after
+             * the first thread count since they don't depend on it */
+            if ((par_only || t > 0) && is_sequential) {
+              continue;
+            }
+            /* and the dense methods on graphs too large for them, unless
+             * they were asked for */
+            if (is_dense && methods_list == NULL && !GRAPH_fits_dense(G)) {
+              continue;
+            }
+
+            res.coloring_method = GRAPH_coloring_methods[method];
+            if (fixed_seed) {
+              res.seed = seed;
+            } else {
+              seed_state = UTIL_splitmix64(seed_state);
+              res.seed = seed_state;
+            }
+            if (method == GRAPH_AUTO) {
+              unsigned int auto_threads;
+              const char *auto_method =
+                  GRAPH_auto_select(G, n_threads, &auto_threads);
+              printf("auto selected %s with %d threads\n", auto_method,
+                     auto_threads);
+            }
+            /* color the graph */
+            PROF_counters_start(&res.counters);
+            start = UTIL_get_time();
+            unsigned int *colors =
+                GRAPH_context_color(ctx, G, method, res.seed, NULL);
+            finish = UTIL_get_time();
+            PROF_counters_stop(&res.counters);
+            if (res.counters.enabled) {
+              /* the calling thread's counts, plus the workers' ones */
+              PROF_counters_add(&res.counters, GRAPH_context_get_counters(ctx));
+            }
+
+            /* if the coloring succeeds (i.e: GRAPH_context_color() returns
+             * something != NULL)*/
+            if (colors != NULL) {
+              res.coloring_time = finish - start;
+              res.profile = GRAPH_context_get_profile(
+                  ctx);  // how the coloring time is split between phases
+
+              /* check whether or not the produced coloring is valid, counting
+               * the colors used and the size of each color class in the same
+               * parallel pass */
+              start = UTIL_get_time();
+              GRAPH_validate_coloring(G, colors, (unsigned int)n_threads,
+                                      GRAPH_MAX_REPORTED_CONFLICTS,
+                                      &res.report);
+              res.validate_time = UTIL_get_time() - start;
+
+              /* even out the size of the color classes if --balance had been
+               * set, this is timed on its own. Only the method's valid
+               * colorings are balanced, then validated again so that the
+               * class sizes are the balanced ones */
+              res.balance_time = 0;
+              if (balance && res.report.valid) {
+                free(res.report.class_size);
+                start = UTIL_get_time();
+                GRAPH_balance_coloring(G, colors);
+                finish = UTIL_get_time();
+                res.balance_time = finish - start;
+                GRAPH_validate_coloring(G, colors, (unsigned int)n_threads,
+                                        GRAPH_MAX_REPORTED_CONFLICTS,
+                                        &res.report);
+              }
+              res.colors_used =
+                  res.report.stats.colors_used;  // the number of colors used is
+                                                 // the maximum color used
+              /* an aborted or failed validation didn't see every vertex, so
+               * its colors and class sizes aren't shown */
+              int complete = !res.report.aborted && !res.report.failed;
+              printf("%12s | %09f  | %09f      | ", res.coloring_method,
+                     res.coloring_time, res.profile->init_time);
+              if (complete) {
+                printf("    %02d      | ", res.colors_used);
+              } else {
+                printf("     -      | ");
+              }
+              if (balance) {
+                printf("%09f   | ", res.balance_time);
+              }
+              if (complete) {
+                printf("%9d | %9d | %12.2f | ",
+                       res.report.stats.min_class_size,
+                       res.report.stats.max_class_size,
+                       res.report.stats.class_size_stddev);
+              } else {
+                printf("%9s | %9s | %12s | ", "-", "-", "-");
+              }
+              free(res.report.class_size);
+
+              if (res.report.valid) {
+                printf("YES \n");
+                method_time[cell] += res.coloring_time;
+                method_runs[cell]++;
+
+                if (output_dir != NULL && k == iterations - 1) {
+                  /* save the coloring of the last iteration */
+                  char output_filename[512];
+                  snprintf(output_filename, sizeof(output_filename),
+                           "%s/%s_%s_%d.%s", output_dir, last,
+                           res.coloring_method, n_threads,
+                           output_text ? "txt" : "colors");
+                  GRAPH_save_coloring(G, colors, output_filename,
+                                      output_text ? GRAPH_OUTPUT_TEXT
+                                                  : GRAPH_OUTPUT_BINARY);
+                }
+
+                if (export) {
+                  // export to csv if flag had been set
+                  csv_file = fopen(csv_filename, "a");
+                  if (csv_file == NULL) {
+                    printf("Error opening %s in append mode\n", csv_filename);
+                  } else {
+                    write_csv_row(csv_file, &res);
+                    fclose(csv_file);
+                  }
+                }
+              } else if (res.report.failed) {
+                all_valid = 0;
+                printf("NO (the validation failed)\n");
+              } else {
+                all_valid = 0;
+                printf("NO (%s%lu conflicting edges, %lu uncolored vertices",
+                       res.report.aborted ? "at least " : "",
+                       res.report.conflicts, res.report.uncolored);
+                for (unsigned int c = 0; c < res.report.n_offenders; c++) {
+                  printf("%s%d-%d", c == 0 ? ", first: " : " ",
+                         res.report.offenders[c].from + 1,
+                         res.report.offenders[c].to + 1);
                 }
+                printf(")\n");
               }
-            } else {
-              printf("NO \n");
             }
           }
         }
       }
+      if (calibration_filename != NULL) {
+        /* remember the method (and thread count) with the lowest average
+         * coloring time */
+        int best = -1;
+        for (int m = 0; m < n_coloring_methods * n_thread_counts; m++) {
+          if (method_runs[m] == iterations &&
+              coloring_methods[m / n_thread_counts] != GRAPH_AUTO &&
+              (best == -1 || method_time[m] < method_time[best])) {
+            best = m;
+          }
+        }
+        if (best != -1) {
+          const char *best_method =
+              GRAPH_coloring_methods[coloring_methods[best / n_thread_counts]];
+          add_calibration_entry(&calibration, &n_calibrated, features,
+                                best_method,
+                                strncmp(best_method, "seq", 3)
+                                    ? thread_counts[best % n_thread_counts]
+                                    : 1);
+        }
+      }
       putchar('\n');
       putchar('\n');
       /* after coloring the graph with each method, finally free it */
@@ -266,5 +1058,39 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  return 0;
+  if (prefetcher.queue != NULL) {
+    QUEUE_close(prefetcher.queue);  // in case the loop stopped early
+    pthread_join(loader, NULL);
+    /* free the graphs that were loaded but not colored */
+    LoadedGraph *loaded;
+    while ((loaded = QUEUE_pop(prefetcher.queue)) != NULL) {
+      GRAPH_free(loaded->G);
+      free(loaded);
+    }
+    QUEUE_free(prefetcher.queue);
+  }
+
+  if (calibration_filename != NULL) {
+    if (n_calibrated > 0 &&
+        CALIB_save(calibration_filename, calibration, n_calibrated)) {
+      printf("Saved %d calibration entries to %s\n", n_calibrated,
+             calibration_filename);
+    } else {
+      printf("No calibration entries saved\n");
+    }
+  }
+  free(calibration);
+  free(method_time);
+  free(method_runs);
+  for (unsigned int t = 0; t < n_thread_counts; t++) {
+    GRAPH_context_free(contexts[t]);
+  }
+  free(contexts);
+  free(coloring_methods);
+  free(thread_counts);
+  if (res.counters.enabled) {
+    PROF_counters_close(&res.counters);
+  }
+
+  return all_valid ? 0 : 5;
 }
\ No newline at end of file
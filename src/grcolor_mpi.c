@@ -0,0 +1,196 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dist.h"
+#include "util.h"
+
+/* Distributed version of grcolor, for graphs that don't fit in the memory of
+ * a single node: every MPI rank loads and colors only its slice of each
+ * graph, e.g.
+ *   mpirun -np 4 ./grcolor_mpi.exe -m seq_ldf graphs/rgg_n_2_20_s0.graph
+ */
+int main(int argc, char *argv[]) {
+  MPI_Init(&argc, &argv);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  DistOrder order = DIST_GREEDY;
+  const char *method_name = "seq_greedy";
+  int iterations = 1;
+  int superstep = DIST_DEFAULT_SUPERSTEP;
+  int fixed_seed = 0;
+  unsigned long long seed = 0;
+  char **graphs_filenames = malloc(argc * sizeof(char *));
+  int number_of_graphs = 0;
+
+  for (int i = 1; i < argc; i++) {
+    /* flag '-m' or '--method' to choose the order in which every rank
+     * colors its own vertices */
+    if (!strcmp(argv[i], "--method") || !strcmp(argv[i], "-m")) {
+      if (i + 1 != argc &&
+          (!strcmp(argv[i + 1], "seq_greedy") ||
+           !strcmp(argv[i + 1], "seq_ldf"))) {
+        method_name = argv[i + 1];
+        order = strcmp(method_name, "seq_ldf") ? DIST_GREEDY : DIST_LDF;
+      } else {
+        if (rank == 0) {
+          printf(
+              "Error: '-m|--method' flag is specified without a valid "
+              "method! (seq_greedy or seq_ldf)\n");
+        }
+        MPI_Finalize();
+        return 1;
+      }
+
+      i++;  // Move to the next flag
+      continue;
+    }
+
+    /* flag '-n' to specify how many times the coloring should be repeated */
+    if (!strcmp(argv[i], "-n")) {
+      if (i + 1 != argc && atoi(argv[i + 1]) > 0) {
+        iterations = atoi(argv[i + 1]);
+      } else {
+        if (rank == 0) {
+          printf(
+              "Error: '-n' flag is specified but the number of iterations is "
+              "invalid! (missing, negative, zero or not numeric)\n");
+        }
+        MPI_Finalize();
+        return 1;
+      }
+
+      i++;  // Move to the next flag
+      continue;
+    }
+
+    /* flag '--superstep' to specify how many boundary vertices every rank
+     * colors between two exchanges of the colors */
+    if (!strcmp(argv[i], "--superstep")) {
+      if (i + 1 != argc && atoi(argv[i + 1]) > 0) {
+        superstep = atoi(argv[i + 1]);
+      } else {
+        if (rank == 0) {
+          printf(
+              "Error: '--superstep' flag is specified but the number of "
+              "vertices is invalid! (missing, negative, zero or not "
+              "numeric)\n");
+        }
+        MPI_Finalize();
+        return 1;
+      }
+
+      i++;  // Move to the next flag
+      continue;
+    }
+
+    /* flag '--seed' to make the resolution of the conflicts reproducible */
+    if (!strcmp(argv[i], "--seed")) {
+      char *end = NULL;
+      if (i + 1 != argc) {
+        seed = strtoull(argv[i + 1], &end, 10);
+      }
+      if (end == NULL || end == argv[i + 1] || *end != '\0') {
+        if (rank == 0) {
+          printf(
+              "Error: '--seed' flag is specified but the seed is invalid! "
+              "(missing or not numeric)\n");
+        }
+        MPI_Finalize();
+        return 1;
+      }
+      fixed_seed = 1;
+
+      i++;  // Move to the next flag
+      continue;
+    }
+
+    /* if an argument is not a known flag, it's treated as a graph's filename
+     */
+    graphs_filenames[number_of_graphs++] = argv[i];
+  }
+
+  if (number_of_graphs == 0 && rank == 0) {
+    printf("Usage: mpirun -np <ranks> %s [-m seq_greedy|seq_ldf] [-n <n>] "
+           "[--superstep <n>] [--seed <n>] GRAPH_PATH...\n", argv[0]);
+  }
+
+  /* every rank must use the same seeds, so rank 0 picks them */
+  unsigned long long seed_state = UTIL_splitmix64(time(NULL) ^ getpid());
+  MPI_Bcast(&seed_state, 1, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+
+  int all_valid = 1;
+  for (int i = 0; i < number_of_graphs; i++) {
+    /* for each graph */
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    DistGraph G = DIST_load_metis(graphs_filenames[i], MPI_COMM_WORLD);
+    double load_time = MPI_Wtime() - start;
+    if (G == NULL) {
+      all_valid = 0;
+      continue;
+    }
+
+    /* take the portion of the filename after the last '/' slash */
+    char *last = strrchr(graphs_filenames[i], '/');
+    last = last != NULL ? last + 1 : graphs_filenames[i];
+    unsigned long ghosts = DIST_get_ghost_count(G);
+    unsigned long total_ghosts;
+    MPI_Reduce(&ghosts, &total_ghosts, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0,
+               MPI_COMM_WORLD);
+    if (rank == 0) {
+      printf(
+          "         GRAPH NAME | RANKS | VERTICES   | EDGES       | LOADED IN | "
+          "GHOSTS\n");
+      printf("%19s | %5d | %10u | %11lu | %09f | %lu\n", last, size,
+             DIST_get_vertex_count(G), DIST_get_edge_count(G), load_time,
+             total_ghosts);
+      printf(
+          "COLOR METHOD | COLORED IN | EXCHANGES | SUPERSTEPS | RECOLORED | "
+          "COLORS USED | VALID?\n");
+    }
+
+    for (int k = 0; k < iterations; k++) {
+      /* for each iteration */
+      if (fixed_seed == 0) {
+        seed_state = UTIL_splitmix64(seed_state);
+        seed = seed_state;
+      }
+      DistReport report;
+      MPI_Barrier(MPI_COMM_WORLD);
+      start = MPI_Wtime();
+      unsigned int *colors = DIST_color(G, order, superstep, seed, &report);
+      double local_time = MPI_Wtime() - start, coloring_time;
+      MPI_Reduce(&local_time, &coloring_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+                 MPI_COMM_WORLD);
+      if (colors == NULL) {
+        all_valid = 0;
+        continue;
+      }
+      if (rank == 0) {
+        printf("%12s | %09f  | %09f | %10u | %9lu |     %02u      | ",
+               method_name, coloring_time, report.exchange_time, report.rounds,
+               report.recolored, report.colors_used);
+        if (report.conflicts == 0) {
+          printf("YES\n");
+        } else {
+          printf("NO (%lu conflicting edges)\n", report.conflicts);
+        }
+      }
+      all_valid &= report.conflicts == 0;
+      free(colors);
+    }
+    if (rank == 0) {
+      putchar('\n');
+    }
+    DIST_free(G);
+  }
+
+  free(graphs_filenames);
+  MPI_Finalize();
+  return all_valid ? 0 : 1;
+}
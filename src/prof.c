@@ -0,0 +1,100 @@
+#include "prof.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+/* opens a counter for the calling thread only: threads that work for it
+ * (e.g. the workers of a coloring context) open and read their own */
+static int open_counter(unsigned long long config) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+/* EXPOSED FUNCTIONS */
+
+int PROF_counters_open(HwCounters *c) {
+  memset(c, 0, sizeof(HwCounters));
+  c->fd_instructions = c->fd_cache_misses = -1;
+  c->instructions = c->cache_misses = -1;
+#ifdef __linux__
+  c->fd_instructions = open_counter(PERF_COUNT_HW_INSTRUCTIONS);
+  c->fd_cache_misses = open_counter(PERF_COUNT_HW_CACHE_MISSES);
+  if (c->fd_instructions < 0 || c->fd_cache_misses < 0) {
+    PROF_counters_close(c);
+    return 0;
+  }
+  c->enabled = 1;
+#endif
+  return c->enabled;
+}
+
+void PROF_counters_start(HwCounters *c) {
+  if (!c->enabled) {
+    return;
+  }
+#ifdef __linux__
+  ioctl(c->fd_instructions, PERF_EVENT_IOC_RESET, 0);
+  ioctl(c->fd_cache_misses, PERF_EVENT_IOC_RESET, 0);
+  ioctl(c->fd_instructions, PERF_EVENT_IOC_ENABLE, 0);
+  ioctl(c->fd_cache_misses, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+void PROF_counters_stop(HwCounters *c) {
+  if (!c->enabled) {
+    return;
+  }
+#ifdef __linux__
+  ioctl(c->fd_instructions, PERF_EVENT_IOC_DISABLE, 0);
+  ioctl(c->fd_cache_misses, PERF_EVENT_IOC_DISABLE, 0);
+  if (read(c->fd_instructions, &c->instructions, sizeof(long long)) !=
+      sizeof(long long)) {
+    c->instructions = -1;
+  }
+  if (read(c->fd_cache_misses, &c->cache_misses, sizeof(long long)) !=
+      sizeof(long long)) {
+    c->cache_misses = -1;
+  }
+#endif
+}
+
+/* adds the counts of other to c, a count that couldn't be read on either side
+ * stays unknown (-1) */
+void PROF_counters_add(HwCounters *c, HwCounters *other) {
+  if (c->instructions < 0 || other->instructions < 0) {
+    c->instructions = -1;
+  } else {
+    c->instructions += other->instructions;
+  }
+  if (c->cache_misses < 0 || other->cache_misses < 0) {
+    c->cache_misses = -1;
+  } else {
+    c->cache_misses += other->cache_misses;
+  }
+}
+
+void PROF_counters_close(HwCounters *c) {
+#ifdef __linux__
+  if (c->fd_instructions >= 0) {
+    close(c->fd_instructions);
+  }
+  if (c->fd_cache_misses >= 0) {
+    close(c->fd_cache_misses);
+  }
+#endif
+  c->fd_instructions = c->fd_cache_misses = -1;
+  c->enabled = 0;
+}
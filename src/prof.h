@@ -0,0 +1,20 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdio.h>
+
+typedef struct hw_counters {
+  int enabled;
+  int fd_instructions;
+  int fd_cache_misses;
+  long long instructions;
+  long long cache_misses;
+} HwCounters;
+
+int PROF_counters_open(HwCounters *c);
+void PROF_counters_start(HwCounters *c);
+void PROF_counters_stop(HwCounters *c);
+void PROF_counters_add(HwCounters *c, HwCounters *other);
+void PROF_counters_close(HwCounters *c);
+
+#endif
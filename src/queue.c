@@ -0,0 +1,90 @@
+#include "queue.h"
+
+struct queue {
+  void **items;  // circular buffer
+  unsigned int capacity;
+  unsigned int head, count;
+  unsigned int closed;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+};
+
+Queue QUEUE_init(unsigned int capacity) {
+  Queue q = malloc(sizeof *q);
+  if (q == NULL) {
+    printf("Error allocating queue!\n");
+    return NULL;
+  }
+  q->items = malloc(capacity * sizeof(void *));
+  if (q->items == NULL) {
+    printf("Error allocating queue items!\n");
+    free(q);
+    return NULL;
+  }
+  q->capacity = capacity;
+  q->head = q->count = 0;
+  q->closed = 0;
+  pthread_mutex_init(&q->lock, NULL);
+  pthread_cond_init(&q->not_empty, NULL);
+  pthread_cond_init(&q->not_full, NULL);
+  return q;
+}
+
+void QUEUE_free(Queue q) {
+  if (q == NULL) {
+    return;
+  }
+  pthread_mutex_destroy(&q->lock);
+  pthread_cond_destroy(&q->not_empty);
+  pthread_cond_destroy(&q->not_full);
+  free(q->items);
+  free(q);
+}
+
+/* Appends item, waiting while the queue is full. Returns 0 (without
+ * appending) if the queue has been closed, 1 otherwise.
+ */
+int QUEUE_push(Queue q, void *item) {
+  pthread_mutex_lock(&q->lock);
+  while (q->count == q->capacity && !q->closed) {
+    pthread_cond_wait(&q->not_full, &q->lock);
+  }
+  if (q->closed) {
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+  }
+  q->items[(q->head + q->count) % q->capacity] = item;
+  q->count++;
+  pthread_cond_signal(&q->not_empty);
+  pthread_mutex_unlock(&q->lock);
+  return 1;
+}
+
+/* Removes the oldest item, waiting while the queue is empty. Returns NULL
+ * once the queue has been closed and every item has been removed.
+ */
+void *QUEUE_pop(Queue q) {
+  pthread_mutex_lock(&q->lock);
+  while (q->count == 0 && !q->closed) {
+    pthread_cond_wait(&q->not_empty, &q->lock);
+  }
+  void *item = NULL;
+  if (q->count > 0) {
+    item = q->items[q->head];
+    q->head = (q->head + 1) % q->capacity;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+  }
+  pthread_mutex_unlock(&q->lock);
+  return item;
+}
+
+/* no more items will be pushed: wakes up every waiting thread */
+void QUEUE_close(Queue q) {
+  pthread_mutex_lock(&q->lock);
+  q->closed = 1;
+  pthread_cond_broadcast(&q->not_empty);
+  pthread_cond_broadcast(&q->not_full);
+  pthread_mutex_unlock(&q->lock);
+}
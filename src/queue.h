@@ -0,0 +1,17 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/* bounded blocking FIFO queue, shared by producer and consumer threads */
+typedef struct queue *Queue;
+
+Queue QUEUE_init(unsigned int capacity);
+void QUEUE_free(Queue q);
+int QUEUE_push(Queue q, void *item);
+void *QUEUE_pop(Queue q);
+void QUEUE_close(Queue q);
+
+#endif
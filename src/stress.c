@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gen.h"
+#include "graph.h"
+
+/* Stress test of the coloring library, run by 'make stress': colors a few
+ * generated graphs with every method and every number of threads from 1 to
+ * max_threads, each through its own context, and exits with 1 if any
+ * coloring is invalid. Unlike grcolor, the number of threads isn't lowered
+ * to the number of logic processors, so that every interleaving can show up
+ * on small machines too.
+ */
+
+/* small enough for the dense methods to color some of them */
+static char *stress_graphs[] = {"gen:rgg:12", "gen:er:10", "gen:ba:12",
+                                "gen:rmat:12", "gen:grid2d:12"};
+#define N_STRESS_GRAPHS (sizeof(stress_graphs) / sizeof(stress_graphs[0]))
+
+/* colorings of each graph with each method and number of threads, with a
+ * different seed each */
+#define STRESS_RUNS 3
+
+#define STRESS_DEFAULT_THREADS 8
+
+int main(int argc, char *argv[]) {
+  int max_threads = argc > 1 ? atoi(argv[1]) : STRESS_DEFAULT_THREADS;
+  if (max_threads < 1) {
+    fprintf(stderr, "Usage: %s [max_threads]\n", argv[0]);
+    return 2;
+  }
+
+  Graph graphs[N_STRESS_GRAPHS];
+  for (unsigned int g = 0; g < N_STRESS_GRAPHS; g++) {
+    graphs[g] = GEN_generate(stress_graphs[g], 1, GEN_DEFAULT_SEED);
+    if (graphs[g] == NULL) {
+      return 2;
+    }
+  }
+
+  unsigned long colorings = 0, invalid = 0;
+  for (unsigned int n_threads = 1; n_threads <= (unsigned int)max_threads;
+       n_threads++) {
+    ColoringContext ctx = GRAPH_context_create(n_threads);
+    if (ctx == NULL) {
+      return 2;
+    }
+    for (unsigned int g = 0; g < N_STRESS_GRAPHS; g++) {
+      Graph G = graphs[g];
+      for (int method = 0; method < GRAPH_N_COLORING_METHODS; method++) {
+        if ((method == GRAPH_SEQ_DENSE_GREEDY ||
+             method == GRAPH_SEQ_DENSE_DSATUR) &&
+            !GRAPH_fits_dense(G)) {
+          continue;
+        }
+        for (unsigned long long seed = 1; seed <= STRESS_RUNS; seed++) {
+          colorings++;
+          unsigned int *colors = GRAPH_context_color(ctx, G, method, seed,
+                                                     NULL);
+          if (colors == NULL) {
+            printf("%s with %s and %u threads (seed %llu): failed\n",
+                   stress_graphs[g], GRAPH_coloring_methods[method],
+                   n_threads, seed);
+            invalid++;
+            continue;
+          }
+          ColoringReport report;
+          GRAPH_validate_coloring(G, colors, n_threads,
+                                  GRAPH_MAX_REPORTED_CONFLICTS, &report);
+          free(report.class_size);
+          if (!report.valid) {
+            printf("%s with %s and %u threads (seed %llu): %lu conflicts, "
+                   "%lu uncolored vertices\n",
+                   stress_graphs[g], GRAPH_coloring_methods[method],
+                   n_threads, seed, report.conflicts, report.uncolored);
+            invalid++;
+          }
+        }
+      }
+    }
+    GRAPH_context_free(ctx);
+  }
+
+  for (unsigned int g = 0; g < N_STRESS_GRAPHS; g++) {
+    GRAPH_free(graphs[g]);
+  }
+  printf("%lu colorings with 1 to %d threads, %lu invalid\n", colorings,
+         max_threads, invalid);
+  return invalid ? 1 : 0;
+}
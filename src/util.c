@@ -1,6 +1,7 @@
 #include "util.h"
 
 #include <stdlib.h>
+#include <sys/mman.h>
 
 static void swap_uint(unsigned int *a, unsigned int *b) {
   int temp;
@@ -96,22 +97,34 @@ unsigned int UTIL_smallest_missing_number(int *arr, unsigned int size) {
 }
 
 double UTIL_get_time() {
-  struct timeval t;
-  struct timezone tzp;
-  gettimeofday(&t, &tzp);
-  return t.tv_sec + t.tv_usec * 1e-6;
+  // monotonic clock, so that measured intervals are never affected by changes
+  // to the system time
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
 }
 
-void UTIL_randomize_array(unsigned int arr[], unsigned int n) {
-  // Use a different seed value so that we don't get same
-  // result each time we run this program
-  srand(time(NULL));
+unsigned long long UTIL_splitmix64(unsigned long long x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+unsigned int UTIL_hash_random(unsigned long long seed,
+                              unsigned long long counter) {
+  // Counter-based generator: the i-th number only depends on the seed and on
+  // i, so it can be computed by any thread, in any order, with the same result
+  return (unsigned int)(UTIL_splitmix64(UTIL_splitmix64(seed) ^ counter) >> 32);
+}
 
+void UTIL_randomize_array(unsigned int arr[], unsigned int n,
+                          unsigned long long seed) {
   // Start from the last element and swap one by one. We don't
   // need to run for the first element that's why i > 0
   for (int i = n - 1; i > 0; i--) {
     // Pick a random index from 0 to i
-    int j = rand() % (i + 1);
+    int j = UTIL_hash_random(seed, i) % (i + 1);
 
     // Swap arr[i] with the element at random index
     swap_uint(&arr[i], &arr[j]);
@@ -169,4 +182,60 @@ void UTIL_stable_qsort_values_by_keys(unsigned int keys[], unsigned int values[]
   }
 
   free(a);
-}
\ No newline at end of file
+}
+
+static unsigned long round_to_huge_pages(unsigned long size) {
+  return (size + UTIL_HUGE_PAGE_SIZE - 1) & ~(UTIL_HUGE_PAGE_SIZE - 1);
+}
+
+/* Allocates size bytes on 2 MB pages, so that random accesses to a large
+ * array need fewer TLB entries: from the reserved pool (MAP_HUGETLB) if it
+ * has enough free pages, else on 2 MB aligned memory advised for transparent
+ * huge pages, which the kernel may or may not grant. Arrays smaller than
+ * UTIL_HUGE_PAGE_MIN bytes are allocated with malloc(), since they'd waste
+ * most of a huge page. kind is set to how the memory is backed. The memory
+ * must be released with UTIL_free_huge() and the same size.
+ */
+void *UTIL_alloc_huge(unsigned long size, PageKind *kind) {
+  *kind = UTIL_PAGES_SMALL;
+  if (size < UTIL_HUGE_PAGE_MIN) {
+    return malloc(size);
+  }
+  unsigned long rounded = round_to_huge_pages(size);
+  void *p = mmap(NULL, rounded, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (p != MAP_FAILED) {
+    *kind = UTIL_PAGES_HUGETLB;
+    return p;
+  }
+
+  /* map one more huge page and trim both ends to align the block */
+  char *raw = mmap(NULL, rounded + UTIL_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) {
+    return NULL;
+  }
+  char *aligned = (char *)round_to_huge_pages((unsigned long)raw);
+  if (aligned > raw) {
+    munmap(raw, aligned - raw);
+  }
+  unsigned long tail = raw + UTIL_HUGE_PAGE_SIZE - aligned;
+  if (tail > 0) {
+    munmap(aligned + rounded, tail);
+  }
+  if (!madvise(aligned, rounded, MADV_HUGEPAGE)) {
+    *kind = UTIL_PAGES_TRANSPARENT;
+  }
+  return aligned;
+}
+
+void UTIL_free_huge(void *p, unsigned long size) {
+  if (p == NULL) {
+    return;
+  }
+  if (size < UTIL_HUGE_PAGE_MIN) {
+    free(p);
+  } else {
+    munmap(p, round_to_huge_pages(size));
+  }
+}
@@ -7,14 +7,31 @@
 #include <sys/resource.h>
 #include <sys/time.h>
 
+#define UTIL_HUGE_PAGE_SIZE (2UL << 20)
+/* smaller arrays aren't worth a huge page */
+#define UTIL_HUGE_PAGE_MIN (UTIL_HUGE_PAGE_SIZE / 2)
+
+/* how the memory returned by UTIL_alloc_huge() is backed */
+typedef enum {
+  UTIL_PAGES_SMALL,        // regular pages
+  UTIL_PAGES_TRANSPARENT,  // advised for transparent huge pages
+  UTIL_PAGES_HUGETLB       // pages reserved in the hugetlbfs pool
+} PageKind;
+
 double UTIL_get_time();
 unsigned int UTIL_smallest_missing_number(int *arr, unsigned int size);
-void UTIL_randomize_array(unsigned int arr[], unsigned int n);
+unsigned long long UTIL_splitmix64(unsigned long long x);
+unsigned int UTIL_hash_random(unsigned long long seed,
+                              unsigned long long counter);
+void UTIL_randomize_array(unsigned int arr[], unsigned int n,
+                          unsigned long long seed);
 void UTIL_print_array(unsigned int arr[], int n);
 void UTIL_heapsort_values_by_keys(unsigned int n, unsigned int keys[],
                         unsigned int values[]);
 unsigned int UTIL_max_in_array(unsigned int arr[], unsigned int size);
 void UTIL_stable_qsort_values_by_keys(unsigned int degrees[], unsigned int indexes[],
                              unsigned int n);
+void *UTIL_alloc_huge(unsigned long size, PageKind *kind);
+void UTIL_free_huge(void *p, unsigned long size);
 
 #endif
\ No newline at end of file